@@ -0,0 +1,655 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Batch conversion of many videos. Up to a set number of conversions run at once,
+**		each with its own pipeline and bus watch, and a status report is given at the end.
+**		Each video goes to its own sub-directory of the output location.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Writer statistics totalled
+**	18-Oct-2026	Videos discovered up front, several at once
+**	18-Oct-2026	Frame index per video
+**
+*/
+
+
+
+/* Defines */
+
+#define BATCH_QUEUED 0
+#define BATCH_RUNNING 1
+#define BATCH_OK 2
+#define BATCH_FAILED 3
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _batch Batch;
+
+typedef struct _batch_job
+{
+    AppData app_data;			/* Conversion for this video */
+    Batch *batch;
+    int status;
+    int discovered;			/* TRUE or FALSE when known, -1 while being discovered */
+    gint64 t_start;			/* Monotonic time (microseconds) */
+    gint64 t_end;
+} BatchJob;
+
+struct _batch
+{
+    AppData *parent;			/* Conversion as set up by the user */
+    BatchJob *jobs;
+    int n_jobs;
+    int max_jobs;			/* Most conversions at once */
+    int next;				/* Next job to start */
+    int active;				/* Jobs running */
+    int started;			/* Parent told that conversion has started */
+    void *disc;				/* Discovery service (discover.c), NULL if not needed */
+    gint64 t_start;
+    guint progress_id;
+    guint idle_id;
+};
+
+
+/* Prototypes */
+
+int batch_add(AppData *, GPtrArray *, char *);
+static gint batch_cmp(gconstpointer, gconstpointer);
+int batch_convert(AppData *, GPtrArray *, int);
+static char * batch_out_dir(Batch *, int, char *);
+static void batch_start(Batch *);
+static int batch_job_start(BatchJob *);
+static int batch_disc_req(AppData *);
+static void batch_report(Batch *, int *);
+static void batch_free(Batch *);
+static void job_msg(char *, char *, void *);
+static void job_status(char *, void *);
+static int job_query(char *, char *, void *);
+static void job_started(void *);
+static void job_finished(int, void *);
+static void job_discovered(AppData *, int, void *);
+static gboolean batch_next(gpointer);
+static gboolean batch_progress(gpointer);
+
+extern int run_conversion(AppData *);
+extern void end_conversion(AppData *, int);
+extern int validate_period(AppData *);
+extern void eng_msg(AppData *, char *, char *);
+extern void eng_status(AppData *, char *);
+extern int check_file(char *);
+extern int check_dir(char *);
+extern int make_dir(char *);
+extern void writer_stats_add(WriteStats *, WriteStats *);
+extern void * disc_new(int);
+extern int disc_add(void *, AppData *, char *, void (*)(AppData *, int, void *), void *);
+extern void disc_free(void *);
+extern void findex_free(AppData *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-batch.c ";
+
+
+/* Add a video, or all the videos matching a pattern (* and ?), to the list */
+
+int batch_add(AppData *app_data, GPtrArray *list, char *s)
+{
+    GDir *dir;
+    const gchar *nm;
+    gchar *dir_nm, *patt;
+    GPtrArray *found;
+    int i;
+
+    if (strpbrk(s, "*?") == NULL)
+    {
+	g_ptr_array_add (list, g_strdup (s));
+	return TRUE;
+    }
+
+    /* Only the file name part may have a wildcard */
+    dir_nm = g_path_get_dirname (s);
+    patt = g_path_get_basename (s);
+
+    if ((dir = g_dir_open (dir_nm, 0, NULL)) == NULL)
+    {
+	eng_msg(app_data, "MSG0008", dir_nm);
+	g_free (dir_nm);
+	g_free (patt);
+	return FALSE;
+    }
+
+    found = g_ptr_array_new ();
+
+    while((nm = g_dir_read_name (dir)) != NULL)
+    {
+	if (g_pattern_match_simple (patt, nm))
+	    g_ptr_array_add (found, g_build_filename (dir_nm, nm, NULL));
+    }
+
+    g_dir_close (dir);
+
+    if (found->len == 0)
+    {
+	sprintf(app_msg_extra, "Pattern: %s\n", s);
+	eng_msg(app_data, "MSG0004", "matching videos");
+    }
+
+    /* Directory order is arbitrary, so sort for a repeatable batch */
+    g_ptr_array_sort (found, batch_cmp);
+
+    for(i = 0; i < found->len; i++)
+	g_ptr_array_add (list, g_ptr_array_index (found, i));
+
+    i = found->len;
+    g_ptr_array_free (found, TRUE);
+    g_free (dir_nm);
+    g_free (patt);
+
+    return (i > 0) ? TRUE : FALSE;
+}
+
+
+/* Run a conversion for each video in the list, no more than max_jobs at once */
+
+int batch_convert(AppData *app_data, GPtrArray *list, int max_jobs)
+{
+    Batch *batch;
+    BatchJob *job;
+    AppData *ad;
+    int i;
+
+    if (list->len == 0)
+    {
+	eng_msg(app_data, "MSG0004", "videos to convert");
+    	return FALSE;
+    }
+
+    batch = (Batch *) malloc(sizeof(Batch));
+    memset(batch, 0, sizeof(Batch));
+    batch->parent = app_data;
+    batch->n_jobs = list->len;
+    batch->max_jobs = (max_jobs < 1) ? 1 : max_jobs;
+    batch->jobs = (BatchJob *) malloc(sizeof(BatchJob) * batch->n_jobs);
+    batch->t_start = g_get_monotonic_time ();
+
+    app_data->img_file_count = 0;
+    memset(&(app_data->wr_stats), 0, sizeof(WriteStats));
+
+    for(i = 0; i < batch->n_jobs; i++)
+    {
+	job = &(batch->jobs[i]);
+	job->batch = batch;
+	job->status = BATCH_QUEUED;
+	job->discovered = TRUE;
+	job->t_start = 0;
+	job->t_end = 0;
+
+	/* Copy the user settings, but nothing belonging to a pipeline */
+	ad = &(job->app_data);
+	memcpy(ad, app_data, sizeof(AppData));
+	memset(&(ad->gst_objs), 0, sizeof(app_gst_objs));
+	ad->c_pipeline = NULL;
+	ad->filenm_tmpl = NULL;
+	ad->info_txt = NULL;
+	ad->discoverer = NULL;
+	ad->loop = NULL;
+	ad->img_file_count = 0;
+	ad->pool = NULL;
+	ad->writer = NULL;
+	ad->findex = NULL;
+
+	// Share the processors between the videos running at once
+	if (ad->enc_threads == 0)
+	    ad->enc_threads = MAX(1, (int) g_get_num_processors () / batch->max_jobs);
+
+	ad->video_fn = strdup((char *) g_ptr_array_index (list, i));
+	ad->video_fn_last = (char *) malloc(2);
+	ad->video_fn_last[0] = '\0';
+	ad->output_dir = batch_out_dir(batch, i, ad->video_fn);
+
+	ad->cb.msg = &job_msg;
+	ad->cb.status = &job_status;
+	ad->cb.query = &job_query;
+	ad->cb.started = &job_started;
+	ad->cb.finished = &job_finished;
+	ad->cb.data = (void *) job;
+    }
+
+    /* Discover all the videos now, several at once, rather than each one as its turn comes */
+    if (batch_disc_req(app_data) == TRUE)
+    {
+	batch->disc = disc_new(app_data->disc_max);
+
+	for(i = 0; i < batch->n_jobs; i++)
+	{
+	    job = &(batch->jobs[i]);
+	    job->discovered = -1;
+	    ad = &(job->app_data);
+
+	    if (disc_add(batch->disc, ad, ad->video_fn, &job_discovered, job) == FALSE)
+		job->discovered = FALSE;
+	}
+    }
+
+    batch->progress_id = g_timeout_add (500, batch_progress, batch);
+
+    /* Start the first lot - the rest start as these finish */
+    batch->idle_id = g_idle_add (batch_next, batch);
+
+    return TRUE;
+}
+
+
+/* Output directory for a video is its name without the extension (made unique in the batch) */
+
+static char * batch_out_dir(Batch *batch, int idx, char *fn)
+{
+    gchar *base, *p, *dir;
+    char suffix[20];
+    int i;
+
+    base = g_path_get_basename (fn);
+
+    if ((p = strrchr(base, '.')) != NULL && p != base)
+    	*p = '\0';
+
+    dir = g_build_filename (batch->parent->output_dir, base, NULL);
+
+    for(i = 0; i < idx; i++)
+    {
+    	if (strcmp(batch->jobs[i].app_data.output_dir, dir) == 0)
+	{
+	    g_free (dir);
+	    sprintf(suffix, "-%d", idx + 1);
+	    p = g_strconcat (base, suffix, NULL);
+	    dir = g_build_filename (batch->parent->output_dir, p, NULL);
+	    g_free (p);
+	    break;
+	}
+    }
+
+    g_free (base);
+
+    return dir;
+}
+
+
+/* Start queued jobs up to the limit */
+
+static void batch_start(Batch *batch)
+{
+    BatchJob *job;
+
+    while(batch->active < batch->max_jobs && batch->next < batch->n_jobs)
+    {
+	job = &(batch->jobs[batch->next]);
+
+	// Jobs start in order, so wait for this one to be discovered
+	if (job->discovered == -1)
+	    break;
+
+	batch->next++;
+
+	job->t_start = g_get_monotonic_time ();
+	job->status = BATCH_RUNNING;
+	batch->active++;
+
+	if (batch_job_start(job) == FALSE)
+	{
+	    job->status = BATCH_FAILED;
+	    job->t_end = g_get_monotonic_time ();
+	    batch->active--;
+	}
+    }
+
+    return;
+}
+
+
+/* Start a conversion pipeline for a job */
+
+static int batch_job_start(BatchJob *job)
+{
+    AppData *ad;
+    void (*finished)(int, void *);
+
+    ad = &(job->app_data);
+
+    if (check_file(ad->video_fn) == FALSE)
+    {
+	eng_msg(ad, "MSG0008", ad->video_fn);
+	return FALSE;
+    }
+
+    if (check_dir(ad->output_dir) == FALSE)
+    {
+	if (make_dir(ad->output_dir) == FALSE)
+	    return FALSE;
+    }
+
+    /* Discovery was done up front */
+    if (job->batch->disc != NULL)
+    {
+	if (job->discovered == FALSE)
+	    return FALSE;
+
+	if ((ad->interval_type == 2 || ad->interval_type == 3) && validate_period(ad) == FALSE)
+	    return FALSE;
+
+	if (ad->interval_type == 4 && ! ad->seekable)
+	{
+	    eng_msg(ad, "MSG0010", NULL);
+	    return FALSE;
+	}
+    }
+
+    if (run_conversion(ad) == FALSE)
+    {
+	// Stop whatever did start (pipeline, frame pool, writer) - the failure is reported by the caller
+	finished = ad->cb.finished;
+	ad->cb.finished = NULL;
+	end_conversion(ad, FALSE);
+	ad->cb.finished = finished;
+
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* A time period needs discovery to validate it, keyframes need a seekable video, */
+/* the sampler needs the frame rate and lower resolution decoding needs the video size */
+
+static int batch_disc_req(AppData *app_data)
+{
+    if ((app_data->interval_type >= 1 && app_data->interval_type <= 4) || app_data->out_width > 0)
+    	return TRUE;
+
+    return FALSE;
+}
+
+
+/* Start more jobs, or finish when there are none left (idle callback) */
+
+static gboolean batch_next(gpointer data)
+{
+    Batch *batch;
+    AppData *app_data;
+    int ok;
+
+    batch = (Batch *) data;
+    batch->idle_id = 0;
+
+    batch_start(batch);
+
+    if (batch->active > 0 || batch->next < batch->n_jobs)
+    	return FALSE;
+
+    /* All done */
+    if (batch->idle_id != 0)
+	g_source_remove (batch->idle_id);
+
+    if (batch->progress_id != 0)
+	g_source_remove (batch->progress_id);
+
+    batch_progress(batch);
+    app_data = batch->parent;
+    app_data->thread_init = FALSE;
+
+    batch_report(batch, &ok);
+    batch_free(batch);
+
+    if (app_data->cb.finished != NULL)
+	(*app_data->cb.finished)(ok, app_data->cb.data);
+
+    return FALSE;
+}
+
+
+/* Per job status and overall throughput */
+
+static void batch_report(Batch *batch, int *ok)
+{
+    BatchJob *job;
+    char s[PATH_MAX + 100];
+    double secs, total_secs;
+    guint images;
+    int i, n_ok;
+
+    n_ok = 0;
+    images = 0;
+
+    for(i = 0; i < batch->n_jobs; i++)
+    {
+	job = &(batch->jobs[i]);
+	secs = (double) (job->t_end - job->t_start) / G_USEC_PER_SEC;
+	images += job->app_data.img_file_count;
+	writer_stats_add(&(batch->parent->wr_stats), &(job->app_data.wr_stats));
+
+	if (job->status == BATCH_OK)
+	    n_ok++;
+
+	snprintf(s, sizeof(s), "%-6s %8u images %9.2fs  %s", 
+		 (job->status == BATCH_OK) ? "ok" : "FAILED", 
+		 job->app_data.img_file_count, secs, job->app_data.video_fn);
+	eng_status(batch->parent, s);
+    }
+
+    total_secs = (double) (g_get_monotonic_time () - batch->t_start) / G_USEC_PER_SEC;
+
+    if (total_secs <= 0)
+    	total_secs = 0.001;
+
+    snprintf(s, sizeof(s), "%d of %d videos ok, %u images in %.2fs (%.1f images/s, %.2f videos/s, %d at once)", 
+	     n_ok, batch->n_jobs, images, total_secs, 
+	     images / total_secs, batch->n_jobs / total_secs, batch->max_jobs);
+    eng_status(batch->parent, s);
+
+    *ok = (n_ok == batch->n_jobs) ? TRUE : FALSE;
+
+    return;
+}
+
+
+/* Free the batch */
+
+static void batch_free(Batch *batch)
+{
+    AppData *ad;
+    int i;
+
+    if (batch->disc != NULL)
+	disc_free(batch->disc);
+
+    for(i = 0; i < batch->n_jobs; i++)
+    {
+	ad = &(batch->jobs[i].app_data);
+	free(ad->video_fn);
+	free(ad->video_fn_last);
+	free(ad->info_txt);
+	findex_free(ad);
+	g_free (ad->output_dir);
+    }
+
+    free(batch->jobs);
+    free(batch);
+
+    return;
+}
+
+
+/* Sort file names */
+
+static gint batch_cmp(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(char **) a, *(char **) b);
+}
+
+
+/***** JOB CALLBACKS *****/
+
+
+/* Messages go to the parent front end */
+
+static void job_msg(char *msg_id, char *opt_str, void *data)
+{
+    BatchJob *job;
+
+    job = (BatchJob *) data;
+
+    if (app_msg_extra[0] == '\0')
+	sprintf(app_msg_extra, "Video: %s\n", job->app_data.video_fn);
+
+    eng_msg(job->batch->parent, msg_id, opt_str);
+
+    return;
+}
+
+
+/* Individual job status is not of interest */
+
+static void job_status(char *s, void *data)
+{
+    return;
+}
+
+
+/* Questions go to the parent front end */
+
+static int job_query(char *msg, char *opt, void *data)
+{
+    BatchJob *job;
+    AppData *parent;
+
+    job = (BatchJob *) data;
+    parent = job->batch->parent;
+
+    if (parent->cb.query == NULL)
+    	return TRUE;
+
+    return (*parent->cb.query)(msg, opt, parent->cb.data);
+}
+
+
+/* First job to play starts the parent */
+
+static void job_started(void *data)
+{
+    BatchJob *job;
+    Batch *batch;
+
+    job = (BatchJob *) data;
+    batch = job->batch;
+
+    if (batch->started == TRUE)
+    	return;
+
+    batch->started = TRUE;
+    batch->parent->thread_init = TRUE;
+
+    if (batch->parent->cb.started != NULL)
+	(*batch->parent->cb.started)(batch->parent->cb.data);
+
+    return;
+}
+
+
+/* A job has finished - start the next one */
+
+static void job_finished(int ok, void *data)
+{
+    BatchJob *job;
+    Batch *batch;
+
+    job = (BatchJob *) data;
+    batch = job->batch;
+
+    job->status = (ok == TRUE) ? BATCH_OK : BATCH_FAILED;
+    job->t_end = g_get_monotonic_time ();
+    batch->active--;
+
+    // This is called from the job's bus watch, so start the next one afterwards
+    if (batch->idle_id == 0)
+	batch->idle_id = g_idle_add (batch_next, batch);
+
+    return;
+}
+
+
+/* A video has been discovered - it may be the one the next job is waiting for */
+
+static void job_discovered(AppData *ad, int ok, void *data)
+{
+    BatchJob *job;
+    Batch *batch;
+
+    job = (BatchJob *) data;
+    batch = job->batch;
+    job->discovered = ok;
+
+    if (batch->idle_id == 0)
+	batch->idle_id = g_idle_add (batch_next, batch);
+
+    return;
+}
+
+/* Total the images from all jobs */
+
+static gboolean batch_progress(gpointer data)
+{
+    Batch *batch;
+    guint total;
+    int i;
+
+    batch = (Batch *) data;
+    total = 0;
+
+    for(i = 0; i < batch->n_jobs; i++)
+	total += batch->jobs[i].app_data.img_file_count;
+
+    batch->parent->img_file_count = total;
+
+    return TRUE;
+}
+
@@ -61,7 +61,7 @@ extern int check_make_dir(char *, GtkWidget *);
 extern void set_convert_widgets(AppData *, MainUi *);
 extern void video_info(AppData *, MainUi *);
 extern void video_convert(AppData *, MainUi *);
-extern int get_video_data(AppData *, MainUi *);
+extern int get_video_data(AppData *, char *);
 extern void reset_form(AppData *, MainUi *);
 extern void free_window_reg();
 extern void close_open_ui();
@@ -0,0 +1,956 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Headless command line conversion. No GTK is used here - the conversion
+**		engine runs on a bare GLib main loop so that jobs can be scripted.
+**
+**		gusto --input video --out dir [--format jpg|png|pnm|bmp|raw] [--every n] ...
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Segment conversion
+**	18-Oct-2026	Batch conversion
+**	18-Oct-2026	Encoder threads
+**	18-Oct-2026	PNG encoder options
+**	18-Oct-2026	RAW frame dump
+**	18-Oct-2026	Pack output
+**	18-Oct-2026	Sharded output
+**	18-Oct-2026	Striped output
+**	18-Oct-2026	Write-behind options and statistics
+**	18-Oct-2026	Output disk free space option
+**	18-Oct-2026	Resume
+**	18-Oct-2026	Discovery cache option
+**	18-Oct-2026	Batch discovery option
+**	18-Oct-2026	Seek index option
+**	18-Oct-2026	Time ranges
+**	18-Oct-2026	Keyframes only needs a seekable video
+**	18-Oct-2026	Ranges reject --mins
+**
+*/
+
+
+
+/* Defines */
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>  
+#include <stdlib.h>  
+#include <string.h>  
+#include <errno.h>  
+#include <getopt.h>  
+#include <gst/gst.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+#include <version.h>
+
+
+/* Prototypes */
+
+int cli_main(int, char **);
+int cli_batch(AppData *);
+int cli_requested(int, char **);
+int cli_options(int, char **, AppData *);
+int cli_number(char *, char *, gint64 *);
+int cli_choice(char *, char *, const char *[]);
+int cli_ranges(char *, AppData *);
+int cli_time(char *, GstClockTime *);
+static int cli_range_cmp(const void *, const void *);
+void cli_usage(char *);
+static void cli_msg(char *, char *, void *);
+static void cli_status(char *, void *);
+static int cli_query(char *, char *, void *);
+static void cli_started(void *);
+static void cli_finished(int, void *);
+static gboolean cli_progress(gpointer);
+static void cli_write_stats(WriteStats *);
+
+extern int run_conversion(AppData *);
+extern int parallel_convert(AppData *, int);
+extern int resume_convert(AppData *);
+extern int batch_add(AppData *, GPtrArray *, char *);
+extern int batch_convert(AppData *, GPtrArray *, int);
+extern int validate_period(AppData *);
+extern int get_video_data(AppData *, char *);
+extern guint frames_to_convert(AppData *);
+extern void get_msg(char*, char*, char*);
+extern int check_file(char *);
+extern int check_dir(char *);
+extern int make_dir(char *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-cli.c ";
+static GMainLoop *cli_loop;
+static int cli_quiet = FALSE;
+static int cli_rc = 0;
+static guint progress_id = 0;
+static int cli_segs = -1;
+static int cli_jobs = 0;
+static GPtrArray *cli_inputs = NULL;
+static GPtrArray *cli_outs = NULL;
+static const char *png_filter_arr[] = { "adaptive", "none", "sub", "up", "avg", "paeth", NULL };	// enum png_filter
+static const char *png_strategy_arr[] = { "default", "filtered", "rle", "huffman", NULL };	// enum png_strategy
+static const char *raw_fmt_arr[] = { "rgb", "gray", "i420", NULL };				// enum raw_fmt
+
+static const struct option cli_opts[] =
+{
+    { "input",		required_argument,	NULL,	'i' },
+    { "out",		required_argument,	NULL,	'o' },
+    { "prefix",		required_argument,	NULL,	'p' },
+    { "format",		required_argument,	NULL,	'f' },
+    { "every",		required_argument,	NULL,	'n' },
+    { "start",		required_argument,	NULL,	's' },
+    { "duration",	required_argument,	NULL,	'd' },
+    { "ranges",		required_argument,	NULL,	'g' },
+    { "mins",		no_argument,		NULL,	'm' },
+    { "keyframes",	no_argument,		NULL,	'k' },
+    { "width",		required_argument,	NULL,	'w' },
+    { "segments",	required_argument,	NULL,	'S' },
+    { "jobs",		required_argument,	NULL,	'j' },
+    { "threads",	required_argument,	NULL,	't' },
+    { "png-level",	required_argument,	NULL,	'z' },
+    { "png-filter",	required_argument,	NULL,	'F' },
+    { "png-strategy",	required_argument,	NULL,	'Z' },
+    { "png-fast",	no_argument,		NULL,	'P' },
+    { "raw-format",	required_argument,	NULL,	'R' },
+    { "pack",		required_argument,	NULL,	'T' },
+    { "shard",		required_argument,	NULL,	'D' },
+    { "stripe-space",	no_argument,		NULL,	'B' },
+    { "write-depth",	required_argument,	NULL,	'Q' },
+    { "sync-write",	no_argument,		NULL,	'Y' },
+    { "min-free",	required_argument,	NULL,	'M' },
+    { "resume",		no_argument,		NULL,	'r' },
+    { "no-cache",	no_argument,		NULL,	'C' },
+    { "probes",		required_argument,	NULL,	'I' },
+    { "seek-index",	no_argument,		NULL,	'K' },
+    { "quiet",		no_argument,		NULL,	'q' },
+    { "version",	no_argument,		NULL,	'v' },
+    { "help",		no_argument,		NULL,	'h' },
+    { NULL,		0,			NULL,	0 }
+};
+
+
+/* Run a conversion from the command line */
+
+int cli_main(int argc, char *argv[])
+{  
+    AppData app_data;
+    char *dir;
+    int i;
+
+    /* Initial */
+    app_msg_extra[0] = '\0';
+    memset(&app_data, 0, sizeof (AppData));
+    app_data.video_fn_last = (char *) malloc(2);
+    app_data.video_fn_last[0] = '\0';
+
+    app_data.cb.msg = &cli_msg;
+    app_data.cb.status = &cli_status;
+    app_data.cb.query = &cli_query;
+    app_data.cb.started = &cli_started;
+    app_data.cb.finished = &cli_finished;
+    app_data.cb.data = (void *) &app_data;
+
+    gst_init (&argc, &argv);
+
+    if (cli_options(argc, argv, &app_data) == FALSE)
+    	return -1;
+
+    /* Create the output directories - there is no one to ask */
+    for(i = 0; i < MAX(1, app_data.n_out_dirs); i++)
+    {
+	dir = (app_data.n_out_dirs > 1) ? app_data.out_dirs[i] : app_data.output_dir;
+
+	if (check_dir(dir) == FALSE)
+	{
+	    if (make_dir(dir) == FALSE)
+		return -1;
+	}
+    }
+
+    /* More than one video is a batch, each checked as it starts */
+    if (cli_inputs->len > 1)
+    	return cli_batch(&app_data);
+
+    if (check_file(app_data.video_fn) == FALSE)
+    {
+	cli_msg("MSG0008", app_data.video_fn, NULL);
+	return -1;
+    }
+
+    /* Discovery costs a full preroll, so only do it when a time period must be validated, */
+    /* keyframes need a seekable video, the video is to be split into segments (or resumed), */
+    /* the sampler needs the frame rate or the decoder can work at a lower resolution */
+    if ((app_data.interval_type >= 1 && app_data.interval_type <= 4) || cli_segs >= 0 || app_data.out_width > 0 ||
+    	app_data.resume == TRUE)
+    {
+	if (get_video_data(&app_data, app_data.video_fn) == FALSE || app_data.video_ok == FALSE)
+	{
+	    if (app_data.info_txt != NULL)
+		fprintf(stderr, "%s", app_data.info_txt);
+
+	    return -1;
+	}
+
+	if ((app_data.interval_type == 2 || app_data.interval_type == 3) && validate_period(&app_data) == FALSE)
+	    return -1;
+
+	if (app_data.interval_type == 4 && ! app_data.seekable)
+	{
+	    cli_msg("MSG0010", NULL, NULL);
+	    return -1;
+	}
+    }
+
+    /* Convert */
+    cli_loop = g_main_loop_new (NULL, FALSE);
+
+    if (cli_segs == 0)
+    	cli_segs = (int) g_get_num_processors ();
+
+    if ((app_data.resume == TRUE && resume_convert(&app_data) == FALSE) ||
+    	(app_data.resume == FALSE && cli_segs > 1 && parallel_convert(&app_data, cli_segs) == FALSE) ||
+        (app_data.resume == FALSE && cli_segs <= 1 && run_conversion(&app_data) == FALSE))
+    {
+	g_main_loop_unref (cli_loop);
+    	return -1;
+    }
+
+    g_main_loop_run (cli_loop);
+    g_main_loop_unref (cli_loop);
+
+    return cli_rc;
+}
+
+
+/* Convert a batch of videos */
+
+int cli_batch(AppData *app_data)
+{  
+    cli_loop = g_main_loop_new (NULL, FALSE);
+
+    if (cli_jobs == 0)
+    	cli_jobs = (int) g_get_num_processors ();
+
+    if (batch_convert(app_data, cli_inputs, cli_jobs) == FALSE)
+    {
+	g_main_loop_unref (cli_loop);
+    	return -1;
+    }
+
+    g_main_loop_run (cli_loop);
+    g_main_loop_unref (cli_loop);
+    g_ptr_array_free (cli_inputs, TRUE);
+    g_ptr_array_free (cli_outs, TRUE);
+
+    return cli_rc;
+}
+
+
+/* Check if the command line asks for a headless run. Any option is ours (so -h, -v and the like */
+/* never need a display) except those GTK and GStreamer take for the user interface. */
+
+int cli_requested(int argc, char *argv[])
+{  
+    const char *ui_opts[] = { "--gtk-", "--gdk-", "--gst-", "--g-fatal-warnings", "--display", 
+    			      "--class", "--name", "--sync" };
+    int i, j, n;
+
+    n = sizeof(ui_opts) / sizeof(ui_opts[0]);
+
+    for(i = 1; i < argc; i++)
+    {
+    	if (argv[i][0] != '-')
+	    continue;
+
+	for(j = 0; j < n; j++)
+	{
+	    if (strncmp(argv[i], ui_opts[j], strlen(ui_opts[j])) == 0)
+		break;
+	}
+
+	if (j >= n)
+	    return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/* Set the user data from the command line options */
+
+int cli_options(int argc, char *argv[], AppData *app_data)
+{  
+    int c;
+    gint64 n;
+    int mins = FALSE;
+    int timed = FALSE;
+    int keys = FALSE;
+
+    /* Defaults */
+    cli_inputs = g_ptr_array_new_with_free_func (g_free);
+    cli_outs = g_ptr_array_new ();
+    app_data->img_prefix = "Image-";
+    app_data->image_type = "JPG";
+    app_data->interval_type = 0;
+    app_data->frame_interval = 1;
+    app_data->time_duration = 0;
+    optind = 1;
+
+    while((c = getopt_long(argc, argv, "i:o:p:f:n:s:d:g:mkw:S:j:t:z:F:Z:PR:T:D:BQ:YM:rCI:Kqvh", cli_opts, NULL)) != -1)
+    {
+	switch(c)
+	{
+	    case 'i':
+		if (batch_add(app_data, cli_inputs, optarg) == FALSE)
+		    return FALSE;
+		break;
+	    case 'o':
+		g_ptr_array_add (cli_outs, optarg);
+		break;
+	    case 'p':
+		app_data->img_prefix = optarg;
+		break;
+	    case 'f':
+		app_data->image_type = g_ascii_strup(optarg, -1);
+		break;
+	    case 'n':
+		if (cli_number(optarg, "Every", &n) == FALSE || n < 1)
+		    return FALSE;
+
+		app_data->frame_interval = (int) n;
+		break;
+	    case 's':
+		if (cli_number(optarg, "Start", &n) == FALSE)
+		    return FALSE;
+
+		app_data->time_start = n;
+		timed = TRUE;
+		break;
+	    case 'd':
+		if (cli_number(optarg, "Duration", &n) == FALSE)
+		    return FALSE;
+
+		app_data->time_duration = n;
+		timed = TRUE;
+		break;
+	    case 'g':
+		if (cli_ranges(optarg, app_data) == FALSE)
+		    return FALSE;
+		break;
+	    case 'm':
+		mins = TRUE;
+		break;
+	    case 'k':
+		keys = TRUE;
+		break;
+	    case 'w':
+		if (cli_number(optarg, "Width", &n) == FALSE)
+		    return FALSE;
+
+		app_data->out_width = (int) n;
+		break;
+	    case 'S':
+		if (cli_number(optarg, "Segments", &n) == FALSE)
+		    return FALSE;
+
+		cli_segs = (int) n;
+		break;
+	    case 'j':
+		if (cli_number(optarg, "Jobs", &n) == FALSE)
+		    return FALSE;
+
+		cli_jobs = (int) n;
+		break;
+	    case 't':
+		if (cli_number(optarg, "Threads", &n) == FALSE)
+		    return FALSE;
+
+		app_data->enc_threads = (int) n;
+		break;
+	    case 'z':
+		if (cli_number(optarg, "PNG level", &n) == FALSE)
+		    return FALSE;
+
+		if (n < 1 || n > 9)
+		{
+		    cli_msg("MSG0001", "PNG level (1 - 9)", NULL);
+		    return FALSE;
+		}
+
+		app_data->png_level = (int) n;
+		break;
+	    case 'F':
+		if ((app_data->png_filter = cli_choice(optarg, "PNG filter", png_filter_arr)) < 0)
+		    return FALSE;
+		break;
+	    case 'Z':
+		if ((app_data->png_strategy = cli_choice(optarg, "PNG strategy", png_strategy_arr)) < 0)
+		    return FALSE;
+		break;
+	    case 'P':
+		// Archival dumps - much faster for somewhat bigger files
+		app_data->png_level = 1;
+		app_data->png_filter = PNG_FLT_UP;
+		app_data->png_strategy = PNG_STRAT_RLE;
+		break;
+	    case 'R':
+		if ((app_data->raw_fmt = cli_choice(optarg, "RAW format", raw_fmt_arr)) < 0)
+		    return FALSE;
+		break;
+	    case 'T':
+		app_data->pack_fn = optarg;
+		break;
+	    case 'D':
+		if (cli_number(optarg, "Shard", &n) == FALSE)
+		    return FALSE;
+
+		if (n < 2 || n > 100000)
+		{
+		    cli_msg("MSG0001", "Shard (2 - 100000)", NULL);
+		    return FALSE;
+		}
+
+		app_data->shard_fanout = (int) n;
+		break;
+	    case 'B':
+		app_data->stripe_space = TRUE;
+		break;
+	    case 'Q':
+		if (cli_number(optarg, "Write depth", &n) == FALSE)
+		    return FALSE;
+
+		if (n < 1 || n > 4096)
+		{
+		    cli_msg("MSG0001", "Write depth (1 - 4096)", NULL);
+		    return FALSE;
+		}
+
+		app_data->write_depth = (int) n;
+		break;
+	    case 'Y':
+		app_data->sync_write = TRUE;
+		break;
+	    case 'r':
+		app_data->resume = TRUE;
+		break;
+	    case 'C':
+		app_data->no_dcache = TRUE;
+		break;
+	    case 'K':
+		app_data->seek_index = TRUE;
+		break;
+	    case 'I':
+		if (cli_number(optarg, "Probes", &n) == FALSE)
+		    return FALSE;
+
+		if (n < 1 || n > 256)
+		{
+		    cli_msg("MSG0001", "Probes (1 - 256)", NULL);
+		    return FALSE;
+		}
+
+		app_data->disc_max = (int) n;
+		break;
+	    case 'M':
+		if (cli_number(optarg, "Min free", &n) == FALSE)
+		    return FALSE;
+
+		app_data->min_free = (n == 0) ? -1 : (int) MIN(n, G_MAXINT);
+		break;
+	    case 'q':
+		cli_quiet = TRUE;
+		break;
+	    case 'v':
+		printf("%s %s\n", TITLE, VERSION);
+		exit(0);
+	    case 'h':
+		cli_usage(argv[0]);
+		exit(0);
+	    default:
+		cli_usage(argv[0]);
+		return FALSE;
+	}
+    }
+
+    /* Any other arguments are more videos */
+    for(; optind < argc; optind++)
+    {
+	if (batch_add(app_data, cli_inputs, argv[optind]) == FALSE)
+	    return FALSE;
+    }
+
+    /* Mandatory */
+    if (cli_inputs->len == 0)
+    {
+	cli_msg("MSG0002", "--input", NULL);
+	return FALSE;
+    }
+
+    if (cli_inputs->len == 1)
+	app_data->video_fn = strdup((char *) g_ptr_array_index (cli_inputs, 0));
+    else if (cli_segs >= 0)
+    {
+	cli_msg("MSG0001", "--segments (with more than one video)", NULL);
+	return FALSE;
+    }
+
+    // Resuming makes its own segments, one video at a time
+    if (app_data->resume == TRUE && (cli_segs >= 0 || cli_inputs->len > 1))
+    {
+	cli_msg("MSG0001", "--resume (with --segments or more than one video)", NULL);
+	return FALSE;
+    }
+
+    // Segments would all be writing the one RAW file
+    if (cli_segs >= 0 && strcmp(app_data->image_type, "RAW") == 0)
+    {
+	cli_msg("MSG0001", "--segments (with raw)", NULL);
+	return FALSE;
+    }
+
+    // More than one output directory stripes the images over them, the first has the manifest
+    if (cli_outs->len > 0)
+	app_data->output_dir = (char *) g_ptr_array_index (cli_outs, 0);
+
+    if (cli_outs->len > 1)
+    {
+	if (app_data->pack_fn != NULL || cli_inputs->len > 1 || (strcmp(app_data->image_type, "JPG") != 0 && 
+	    strcmp(app_data->image_type, "PNG") != 0 && strcmp(app_data->image_type, "BMP") != 0))
+	{
+	    cli_msg("MSG0001", "--out (more than one only for jpg, png or bmp files from one video)", NULL);
+	    return FALSE;
+	}
+
+	app_data->out_dirs = (char **) cli_outs->pdata;
+	app_data->n_out_dirs = (int) cli_outs->len;
+    }
+    else if (app_data->stripe_space == TRUE)
+    {
+	cli_msg("MSG0001", "--stripe-space (with one --out)", NULL);
+	return FALSE;
+    }
+
+    // One archive holds the images from one pipeline, written in frame order
+    if (app_data->pack_fn != NULL)
+    {
+	if (cli_segs >= 0 || cli_inputs->len > 1)
+	{
+	    cli_msg("MSG0001", "--pack (with --segments or more than one video)", NULL);
+	    return FALSE;
+	}
+
+	if (strcmp(app_data->image_type, "JPG") != 0 && strcmp(app_data->image_type, "PNG") != 0 && 
+	    strcmp(app_data->image_type, "BMP") != 0)
+	{
+	    cli_msg("MSG0001", "--pack (only jpg, png or bmp)", NULL);
+	    return FALSE;
+	}
+
+	if (app_data->output_dir == NULL)
+	    app_data->output_dir = ".";
+    }
+
+    // Shards are made by the frame pool as the image files are written
+    if (app_data->shard_fanout > 0)
+    {
+	if (app_data->pack_fn != NULL || (strcmp(app_data->image_type, "JPG") != 0 && 
+	    strcmp(app_data->image_type, "PNG") != 0 && strcmp(app_data->image_type, "BMP") != 0))
+	{
+	    cli_msg("MSG0001", "--shard (only jpg, png or bmp files)", NULL);
+	    return FALSE;
+	}
+    }
+
+    if (app_data->output_dir == NULL)
+    {
+	cli_msg("MSG0002", "--out", NULL);
+	return FALSE;
+    }
+
+    /* A list of time ranges is converted in one pass, instead of one period */
+    if (app_data->n_ranges > 0)
+    {
+	if (timed == TRUE || mins == TRUE || cli_segs >= 0 || app_data->resume == TRUE)
+	{
+	    cli_msg("MSG0001", "--ranges (with --start, --duration, --mins, --segments or --resume)", NULL);
+	    return FALSE;
+	}
+
+	timed = TRUE;
+    }
+
+    /* Same selection types as the user interface */
+    if (keys == TRUE)
+    {
+	if (timed == TRUE || app_data->frame_interval > 1 || cli_segs >= 0)
+	{
+	    cli_msg("MSG0001", "--keyframes (with --every, a time period or --segments)", NULL);
+	    return FALSE;
+	}
+
+	app_data->interval_type = 4;
+	app_data->init_state = GST_STATE_PAUSED;
+    }
+    else if (timed == TRUE)
+    {
+	if (app_data->frame_interval > 1)
+	{
+	    cli_msg("MSG0001", "--every (with a time period)", NULL);
+	    return FALSE;
+	}
+
+	app_data->interval_type = (mins == TRUE) ? 3 : 2;
+	app_data->init_state = GST_STATE_PAUSED;
+    }
+    else
+    {
+	app_data->interval_type = (app_data->frame_interval > 1) ? 1 : 0;
+	app_data->init_state = GST_STATE_PLAYING;
+    }
+
+    return TRUE;
+}
+
+
+/* Convert and validate a numeric option */
+
+int cli_number(char *s, char *nm, gint64 *n)
+{  
+    char *end;
+
+    errno = 0;
+    *n = g_ascii_strtoll(s, &end, 10);
+
+    if (errno != 0 || *end != '\0' || end == s || *n < 0)
+    {
+	cli_msg("MSG0001", nm, NULL);
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* Find a named option value - the index in the list */
+
+int cli_choice(char *s, char *nm, const char *arr[])
+{  
+    int i;
+
+    for(i = 0; arr[i] != NULL; i++)
+    {
+    	if (g_ascii_strcasecmp(s, arr[i]) == 0)
+	    return i;
+    }
+
+    cli_msg("MSG0001", nm, NULL);
+
+    return -1;
+}
+
+
+/* Time ranges, eg. 1:00-1:30,12:00-12:10 (no end for the rest of the video). */
+/* They are put in order and any that overlap or meet are joined. */
+
+int cli_ranges(char *s, AppData *app_data)
+{  
+    gchar **list;
+    GstClockTime *r;
+    char *p;
+    int i, j, n, ok;
+
+    list = g_strsplit (s, ",", -1);
+    n = (int) g_strv_length (list);
+    r = (GstClockTime *) malloc(sizeof(GstClockTime) * 2 * MAX(n, 1));
+    ok = (n > 0);
+
+    for(i = 0; i < n && ok == TRUE; i++)
+    {
+	if ((p = strchr(list[i], '-')) == NULL)
+	{
+	    ok = FALSE;
+	    break;
+	}
+
+	*p++ = '\0';
+	ok = cli_time(list[i], &(r[i * 2]));
+
+	if (ok == TRUE && *p == '\0')
+	    r[i * 2 + 1] = GST_CLOCK_TIME_NONE;
+	else if (ok == TRUE)
+	    ok = (cli_time(p, &(r[i * 2 + 1])) == TRUE && r[i * 2 + 1] > r[i * 2]);
+    }
+
+    g_strfreev (list);
+
+    if (ok == FALSE)
+    {
+	free(r);
+	cli_msg("MSG0001", "Ranges", NULL);
+	return FALSE;
+    }
+
+    // No end (GST_CLOCK_TIME_NONE) is later than any time
+    qsort(r, n, sizeof(GstClockTime) * 2, cli_range_cmp);
+
+    for(i = 0, j = 0; i < n; i++)
+    {
+	if (j > 0 && r[i * 2] <= r[j * 2 - 1])
+	{
+	    r[j * 2 - 1] = MAX(r[j * 2 - 1], r[i * 2 + 1]);
+	    continue;
+	}
+
+	r[j * 2] = r[i * 2];
+	r[j * 2 + 1] = r[i * 2 + 1];
+	j++;
+    }
+
+    free(app_data->ranges);
+    app_data->ranges = r;
+    app_data->n_ranges = j;
+
+    return TRUE;
+}
+
+
+/* A time as seconds, minutes:seconds or hours:minutes:seconds (seconds may have a fraction) */
+
+int cli_time(char *s, GstClockTime *t)
+{  
+    gchar **part;
+    char *end;
+    guint64 n;
+    gdouble secs;
+    int i, len, ok;
+
+    part = g_strsplit (s, ":", -1);
+    len = (int) g_strv_length (part);
+    ok = (len >= 1 && len <= 3);
+    *t = 0;
+
+    for(i = 0; i < len - 1 && ok == TRUE; i++)
+    {
+	n = g_ascii_strtoull (part[i], &end, 10);
+	ok = (g_ascii_isdigit (part[i][0]) && *end == '\0');
+	*t = (*t + n) * 60;
+    }
+
+    if (ok == TRUE)
+    {
+	secs = g_ascii_strtod (part[len - 1], &end);
+	ok = (g_ascii_isdigit (part[len - 1][0]) && *end == '\0');
+	*t = (*t * GST_SECOND) + (GstClockTime) (secs * GST_SECOND + 0.5);
+    }
+
+    g_strfreev (part);
+
+    return ok;
+}
+
+
+static int cli_range_cmp(const void *a, const void *b)
+{  
+    GstClockTime t1, t2;
+
+    t1 = *(const GstClockTime *) a;
+    t2 = *(const GstClockTime *) b;
+
+    return (t1 < t2) ? -1 : (t1 > t2);
+}
+
+
+/* Command line help */
+
+void cli_usage(char *prog)
+{  
+    fprintf(stderr, "%s %s - convert video frames to images\n\n", TITLE, VERSION);
+    fprintf(stderr, "Usage: %s --input video --out dir [options] [video ...]\n\n", prog);
+    fprintf(stderr, "  -i, --input file      Video file to convert (may be repeated or use * and ?)\n");
+    fprintf(stderr, "  -o, --out dir         Output location (created if required, repeat to stripe the images)\n");
+    fprintf(stderr, "  -p, --prefix str      Image file name prefix (default Image-)\n");
+    fprintf(stderr, "  -f, --format type     jpg, png, pnm, bmp or raw (default jpg)\n");
+    fprintf(stderr, "  -n, --every n         Convert every nth frame\n");
+    fprintf(stderr, "  -s, --start n         Start of the time period to convert\n");
+    fprintf(stderr, "  -d, --duration n      Length of the time period (0 for the remainder)\n");
+    fprintf(stderr, "  -g, --ranges list     Time ranges to convert in one pass, eg. 1:00-1:30,12:00-12:10\n");
+    fprintf(stderr, "  -m, --mins            Time period is in minutes (default seconds)\n");
+    fprintf(stderr, "  -k, --keyframes       Convert keyframes only (fast, no other frames are decoded)\n");
+    fprintf(stderr, "  -w, --width n         Image width, height keeps the aspect ratio (default video size)\n");
+    fprintf(stderr, "  -S, --segments n      Convert n segments at once (0 for one per processor)\n");
+    fprintf(stderr, "  -j, --jobs n          Videos to convert at once in a batch (default one per processor)\n");
+    fprintf(stderr, "  -t, --threads n       Image encoder threads (default one per processor)\n");
+    fprintf(stderr, "  -z, --png-level n     PNG compression level 1 - 9 (default 6)\n");
+    fprintf(stderr, "  -F, --png-filter type adaptive, none, sub, up, avg or paeth (default adaptive)\n");
+    fprintf(stderr, "  -Z, --png-strategy s  default, filtered, rle or huffman (default default)\n");
+    fprintf(stderr, "  -P, --png-fast        Fast PNG for archiving (level 1, up filter, rle)\n");
+    fprintf(stderr, "  -R, --raw-format type rgb, gray or i420 for raw output (default rgb)\n");
+    fprintf(stderr, "  -T, --pack file       Put the images in one tar archive (- for stdout)\n");
+    fprintf(stderr, "  -D, --shard n         Spread the images over two levels of directories, n in each\n");
+    fprintf(stderr, "  -B, --stripe-space    Stripe over the --out directories by free space (default in turn)\n");
+    fprintf(stderr, "  -Q, --write-depth n   Image files being written at once, behind the encoders (default 64)\n");
+    fprintf(stderr, "  -Y, --sync-write      Encoder threads write their own image files\n");
+    fprintf(stderr, "  -M, --min-free MB     Pause when the output disk gets this full (default 256, 0 for no check, not pnm)\n");
+    fprintf(stderr, "  -r, --resume          Convert only the images not already in the output\n");
+    fprintf(stderr, "  -C, --no-cache        Discover the video again, not from the discovery cache\n");
+    fprintf(stderr, "  -I, --probes n        Videos discovered at once in a batch (default one per processor)\n");
+    fprintf(stderr, "  -K, --seek-index      Keep the frame and keyframe index beside the video for quicker seeks next time\n");
+    fprintf(stderr, "  -q, --quiet           No progress output\n");
+    fprintf(stderr, "  -v, --version         Show the version\n");
+    fprintf(stderr, "  -h, --help            Show this help\n");
+
+    return;
+}
+
+
+/***** ENGINE CALLBACKS *****/
+
+
+/* Engine message - there is no window, so report on stderr */
+
+static void cli_msg(char *msg_id, char *opt_str, void *data)
+{
+    char msg[512];
+
+    get_msg(msg, msg_id, opt_str);
+    fprintf(stderr, "%s: %s\n", TITLE, msg);
+
+    if (app_msg_extra[0] != '\0')
+	fprintf(stderr, "%s\n", app_msg_extra);
+
+    app_msg_extra[0] = '\0';
+
+    return;
+}
+
+
+/* Engine status */
+
+static void cli_status(char *s, void *data)
+{
+    if (cli_quiet == FALSE)
+    {
+	fprintf(stderr, "%s", s);
+
+	if (s[strlen(s) - 1] != '\n')
+	    fprintf(stderr, "\n");
+    }
+
+    return;
+}
+
+
+/* Engine query - nobody to ask, so always go ahead */
+
+static int cli_query(char *msg, char *opt, void *data)
+{
+    if (cli_quiet == FALSE)
+	fprintf(stderr, "%s Yes\n", msg);
+
+    return TRUE;
+}
+
+
+/* Engine started - report progress every second */
+
+static void cli_started(void *data)
+{
+    if (cli_quiet == FALSE)
+	progress_id = g_timeout_add_seconds (1, cli_progress, data);
+
+    return;
+}
+
+
+/* Engine finished */
+
+static void cli_finished(int ok, void *data)
+{
+    AppData *app_data;
+
+    app_data = (AppData *) data;
+
+    if (progress_id != 0)
+    {
+	g_source_remove (progress_id);
+	progress_id = 0;
+    }
+
+    if (ok == FALSE)
+	cli_rc = -1;
+
+    if (cli_quiet == FALSE)
+    {
+	fprintf(stderr, "%s %u images\n", (ok == TRUE) ? "Finished:" : "Failed after", app_data->img_file_count);
+	cli_write_stats(&(app_data->wr_stats));
+    }
+
+    g_main_loop_quit (cli_loop);
+
+    return;
+}
+
+
+/* Progress report */
+
+static gboolean cli_progress(gpointer data)
+{
+    AppData *app_data;
+    guint frames;
+
+    app_data = (AppData *) data;
+    frames = frames_to_convert(app_data);
+
+    if (frames > 0)
+	fprintf(stderr, "Processed %u of %u files (approx.)\n", app_data->img_file_count, frames);
+    else
+	fprintf(stderr, "Processed %u files\n", app_data->img_file_count);
+
+    return TRUE;
+}
+
+
+/* Image file writer statistics, if it was used */
+
+static void cli_write_stats(WriteStats *st)
+{
+    if (st->files == 0)
+    	return;
+
+    fprintf(stderr, "Written: %.1f MB in %.0f files (%s), latency %.1f ms average %.1f ms maximum, "
+		    "%d files at most in flight, encoders waited %.2f s, throttled %d times\n",
+	    (double) st->bytes / (1024 * 1024), (double) st->files, (st->uring == TRUE) ? "io_uring" : "thread",
+	    (double) st->lat_total / st->files / 1000, (double) st->lat_max / 1000, 
+	    st->max_held, (double) st->stall / 1000000, st->throttled);
+
+    return;
+}
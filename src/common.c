@@ -0,0 +1,279 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description:
+**  Error and Message Reference functions
+**  General usage functions
+**  Nothing in here may use GTK - it is shared by the GUI and the command line
+**
+** Author:	Anthony Buckley
+**
+** History
+**	19-Jun-2022	Initial code (utility.c)
+**	18-Oct-2026	Split from utility.c for the headless command line
+**	18-Oct-2026	Disk nearly full message
+**	18-Oct-2026	Messages printed to stderr (stdout may be an archive)
+**
+*/
+
+
+/* Defines */
+
+#define ERR_FILE
+
+
+/* Includes */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <glib.h>
+#include <defs.h>
+
+
+/* Prototypes */
+
+void get_msg(char*, char*, char*);
+void log_msg(char*, char *);
+char * app_msg_text(char*, char *);
+void strlower(char *, char *);
+int check_file(char *);
+int check_dir(char *);
+int make_dir(char *);
+
+
+/* Globals */
+
+static const char *app_messages[][2] =
+{
+    { "MSG0001", "Error: %s has an invalid value. "},
+    { "MSG0002", "Error: Please enter a value for %s. "},
+    { "MSG0003", "%s does not exist. "},
+    { "MSG0004", "Error: No %s found. "},
+    { "MSG0005", "Warning: No %s found. "},
+    { "MSG0006", "File error: %s. "},
+    { "MSG0007", "Failed to create image: %s "},
+    { "MSG0008", "File %s does not exist or cannot be read. "},
+    { "MSG0009", "Error: %s has an invalid value. "},
+    { "MSG0010", "Error: This video is not seekable. Cannot convert a video segment. "},
+    { "MSG0011", "Error: The start point is longer the video duration. "},
+    { "MSG0012", "Output disk is nearly full. Paused after %s images - free some space and resume. "},
+    { "MSG9000", "Session started. "},
+    { "MSG9001", "Session ends. "},
+    { "MSG9003", "Failed to start application. "},
+    { "MSG9004", "Failed to read $HOME variable. "},
+    { "MSG9005", "Debug: %s. "},
+    { "MSG9006", "Failed to get parent container widget. %s "},
+    { "MSG9007", "Failed to find widget. %s "},
+    { "MSG9008", "Failed to create directory: %s "},
+    { "MSG9009", "Not all GST elements could be created. "},
+    { "MSG9010", "GST Pipeline elements could not be linked. "},
+    { "MSG9011", "Unable to set the pipeline to the %s state. "},
+    { "MSG9012", "Pipeline Message: %s received. "},
+    { "MSG9013", "Error video creating discoverer. "},
+    { "MSG9014", "Failed to video discoverer for: %s "},
+    { "MSG9015", "Discoverer info result error: %s "},
+    { "MSG9016", "'Video' file - %s - cannot be played "},
+    { "MSG9017", "Error: Unable to create thread, "},
+    { "MSG9999", "Error - Unknown error message given. "}			// NB - MUST be last
+};
+
+static const int Msg_Count = 30;
+static const char *debug_hdr = "DEBUG-common.c ";
+
+
+/* Log a message with no window to display it in */
+
+void log_msg(char *msg_id, char *opt_str)
+{
+    char msg[512];
+
+    /* Lookup the message */
+    get_msg(msg, msg_id, opt_str);
+    strcat(msg, " \n");
+
+    /* Print the message (stderr, stdout may be carrying output) */
+    fprintf(stderr, "%s: %s\n", TITLE, msg);
+
+    if (app_msg_extra[0] != '\0')
+	fprintf(stderr, "%s\n", app_msg_extra);
+
+    /* Reset global message extra details */
+    app_msg_extra[0] = '\0';
+
+    return;
+}
+
+
+/* Process application messages and error conditions and return text */
+
+char * app_msg_text(char *msg_id, char *opt_str)
+{
+    char msg[512];
+    char *msg_txt;
+    int len;
+
+    /* Lookup the message */
+    get_msg(msg, msg_id, opt_str);
+    strcat(msg, " \n");
+
+    /* Print the message (stderr, stdout may be carrying output) */
+    fprintf(stderr, "%s: %s", TITLE, msg);
+
+    if (app_msg_extra[0] != '\0')
+	fprintf(stderr, "%s\n", app_msg_extra);
+
+    /* Set the text */
+    len = strlen(msg) + strlen(app_msg_extra) + 2;
+    msg_txt = (char *) malloc(len);
+    sprintf(msg_txt, "%s%s\n", msg, app_msg_extra);
+
+    /* Reset global message extra details */
+    app_msg_extra[0] = '\0';
+
+    return msg_txt;
+}
+
+
+/* Message lookup and optional string argument substitution */
+
+void get_msg(char *s, char *msg_id, char *opt_str)
+{
+    int i;
+    char *p, *p2;
+
+    /* Find message */
+    for(i = 0; i < Msg_Count; i++)
+    {
+    	if ((strcmp(msg_id, app_messages[i][0])) == 0)
+	    break;
+    }
+
+    if (i >= Msg_Count)
+    	i--;
+
+    /* Check substitution. If none, show message as is with any '%s' blanked out. */
+    p = (char *) app_messages[i][1];
+    p2 = strstr(p, "%s");
+
+    if ((! opt_str) || (strlen(opt_str) == 0) || (p2 == NULL))
+    {
+	sprintf(s, "(%s) %s", app_messages[i][0], app_messages[i][1]);
+
+	if (p2 != NULL)
+	{
+	    p2 = strstr(s, "%s");
+	    *p2++ = ' ';
+	    *p2 = ' ';
+	}
+
+    	return;
+    }
+
+    /* Add substitution string */
+    *s = '\0';
+    sprintf(s, "(%s) ", app_messages[i][0]);
+
+    for(s = (s + strlen(app_messages[i][0]) + 3); p < p2; p++)
+    	*s++ = *p;
+
+    *s = '\0';
+
+    strcat(s, opt_str);
+    strcat(s, p2 + 2);
+
+    return;
+}
+
+
+/* Convert a string to lowercase */
+
+void strlower(char *s1, char *s2)
+{
+    for(; *s1 != '\0'; s1++, s2++)
+    	*s2 = tolower(*s1);
+
+    *s2 = *s1;
+
+    return;
+}
+
+
+/* Check file exists and can be opened */
+
+int check_file(char *s)
+{
+    struct stat fileStat;
+    int err;
+
+    if ((err = stat(s, &fileStat)) < 0)
+	return FALSE;
+
+    if ((fileStat.st_mode & S_IFMT) == S_IFREG)
+	return TRUE;
+    else
+	return FALSE;
+}
+
+
+/* Check directory exists */
+
+int check_dir(char *s)
+{
+    struct stat fileStat;
+    int err;
+
+    if ((err = stat(s, &fileStat)) < 0)
+	return FALSE;
+
+    if ((fileStat.st_mode & S_IFMT) == S_IFDIR)
+	return TRUE;
+    else
+	return FALSE;
+}
+
+
+/* Create a directory */
+
+int make_dir(char *s)
+{
+    int err;
+
+    #ifdef __linux__
+	err = mkdir(s, 0700);
+    #else
+	err = mkdir(s);
+    #endif
+
+    if (err != 0)
+    {
+	log_msg("MSG9008", s);
+	return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,357 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Discovery cache. The details found by video discovery (duration, frame rate,
+**		seekable, video and audio streams, codec) are kept in a text file in the user
+**		cache directory, keyed by the full path, size and modification time of the video,
+**		so a video that has not changed does not have to be discovered again.
+**		The file is read once and new entries are appended to it, one line each.
+**		It is rewritten when more than half of it is out of date.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**
+*/
+
+
+
+/* Defines */
+
+#define DCACHE_DIR "gusto"
+#define DCACHE_FILE "discovery.txt"
+#define DCACHE_HDR "# Gusto discovery cache 1\n"
+#define DCACHE_FIELDS 11
+#define DCACHE_SETTLE 2			// Seconds a video must be unchanged before it is cached
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _dc_entry
+{
+    gint64 size;			/* Key - with the path */
+    gint64 mtime;			/* Key - nanoseconds where available */
+    GstClockTime duration;
+    guint fr_num;
+    guint fr_denom;
+    guint width;
+    int seekable;
+    int n_video;			/* Video streams */
+    int n_audio;			/* Audio streams */
+    char codec[64];			/* Video caps name, eg. video/x-h264 */
+} DcEntry;
+
+
+/* Prototypes */
+
+int dcache_get(AppData *);
+void dcache_put(AppData *, int, int, const char *);
+static int dcache_key(char *, gint64 *, gint64 *, time_t *);
+static void dcache_load(void);
+static void dcache_line(FILE *, char *, DcEntry *);
+static void dcache_compact(void);
+static char * dcache_fn(void);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-dcache.c ";
+static GMutex dc_mtx;
+static GHashTable *dc_tbl = NULL;
+static int dc_lines = 0;
+
+
+/* Fill in the video details from the cache, TRUE if the video is known and unchanged */
+
+int dcache_get(AppData *app_data)
+{
+    DcEntry *e;
+    gint64 size, mtime;
+    time_t t;
+    int found;
+
+    if (dcache_key(app_data->video_fn, &size, &mtime, &t) == FALSE)
+    	return FALSE;
+
+    g_mutex_lock (&dc_mtx);
+
+    dcache_load();
+    e = (DcEntry *) g_hash_table_lookup (dc_tbl, app_data->video_fn);
+    found = (e != NULL && e->size == size && e->mtime == mtime);
+
+    if (found)
+    {
+	/* As discovery would have set them */
+	app_data->seekable = e->seekable;
+	app_data->video_duration = e->duration;
+
+	if (e->n_video == 1)
+	{
+	    app_data->fr_num = e->fr_num;
+	    app_data->fr_denom = e->fr_denom;
+	    app_data->v_width = e->width;
+	    app_data->mjpeg = (strcmp(e->codec, "image/jpeg") == 0);
+	}
+    }
+
+    g_mutex_unlock (&dc_mtx);
+
+    return found;
+}
+
+
+/* Save the details of a video just discovered */
+
+void dcache_put(AppData *app_data, int n_video, int n_audio, const char *codec)
+{
+    DcEntry *e;
+    FILE *fd;
+    char *fn;
+    time_t t;
+
+    e = (DcEntry *) malloc(sizeof(DcEntry));
+
+    if (dcache_key(app_data->video_fn, &(e->size), &(e->mtime), &t) == FALSE)
+    {
+	free(e);
+    	return;
+    }
+
+    // A video still being written would be out of date straight away
+    if (t + DCACHE_SETTLE > time(NULL))
+    {
+	free(e);
+    	return;
+    }
+
+    e->duration = app_data->video_duration;
+    e->fr_num = app_data->fr_num;
+    e->fr_denom = app_data->fr_denom;
+    e->width = app_data->v_width;
+    e->seekable = (app_data->seekable == TRUE);
+    e->n_video = n_video;
+    e->n_audio = n_audio;
+    g_strlcpy (e->codec, (codec == NULL || *codec == '\0') ? "-" : codec, sizeof(e->codec));
+    g_strdelimit (e->codec, "\t\n", '_');
+
+    g_mutex_lock (&dc_mtx);
+
+    dcache_load();
+    g_hash_table_replace (dc_tbl, g_strdup (app_data->video_fn), e);
+
+    fn = dcache_fn();
+
+    if ((fd = g_fopen (fn, "a")) != NULL)
+    {
+	fseek(fd, 0, SEEK_END);
+
+	if (ftell(fd) == 0)
+	    fputs(DCACHE_HDR, fd);
+
+	dcache_line(fd, app_data->video_fn, e);
+	fclose(fd);
+	dc_lines++;
+    }
+
+    g_free (fn);
+
+    g_mutex_unlock (&dc_mtx);
+
+    return;
+}
+
+
+/* Cache key for a video - size and modification time. A path that cannot go on one line is not cached. */
+
+static int dcache_key(char *path, gint64 *size, gint64 *mtime, time_t *t)
+{
+    GStatBuf st;
+
+    if (path == NULL || strpbrk(path, "\t\n\r") != NULL)
+    	return FALSE;
+
+    if (g_stat (path, &st) != 0)
+    	return FALSE;
+
+    *size = (gint64) st.st_size;
+    *t = st.st_mtime;
+
+#ifdef __linux__
+    *mtime = (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + st.st_mtim.tv_nsec;
+#else
+    *mtime = (gint64) st.st_mtime * G_GINT64_CONSTANT (1000000000);
+#endif
+
+    return TRUE;
+}
+
+
+/* Read the cache file the first time it is needed. Later lines replace earlier ones. */
+
+static void dcache_load()
+{
+    DcEntry *e;
+    gchar *buf, *fn;
+    gchar **lines, **f;
+    int i;
+
+    if (dc_tbl != NULL)
+    	return;
+
+    dc_tbl = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, free);
+    dc_lines = 0;
+    fn = dcache_fn();
+
+    if (g_file_get_contents (fn, &buf, NULL, NULL) == FALSE)
+    {
+	g_free (fn);
+    	return;
+    }
+
+    lines = g_strsplit (buf, "\n", -1);
+    g_free (buf);
+
+    for(i = 0; lines[i] != NULL; i++)
+    {
+	if (lines[i][0] == '#' || lines[i][0] == '\0')
+	    continue;
+
+	dc_lines++;
+
+	// The path is last, so a line cut short by a crash is missing fields
+	f = g_strsplit (lines[i], "\t", DCACHE_FIELDS);
+
+	if (g_strv_length (f) != DCACHE_FIELDS || f[DCACHE_FIELDS - 1][0] == '\0')
+	{
+	    g_strfreev (f);
+	    continue;
+	}
+
+	e = (DcEntry *) malloc(sizeof(DcEntry));
+	e->size = g_ascii_strtoll (f[0], NULL, 10);
+	e->mtime = g_ascii_strtoll (f[1], NULL, 10);
+	e->duration = g_ascii_strtoull (f[2], NULL, 10);
+	e->fr_num = (guint) g_ascii_strtoull (f[3], NULL, 10);
+	e->fr_denom = (guint) g_ascii_strtoull (f[4], NULL, 10);
+	e->width = (guint) g_ascii_strtoull (f[5], NULL, 10);
+	e->seekable = (f[6][0] == 'Y');
+	e->n_video = atoi(f[7]);
+	e->n_audio = atoi(f[8]);
+	g_strlcpy (e->codec, f[9], sizeof(e->codec));
+
+	g_hash_table_replace (dc_tbl, g_strdup (f[DCACHE_FIELDS - 1]), e);
+	g_strfreev (f);
+    }
+
+    g_strfreev (lines);
+    g_free (fn);
+
+    /* Replaced entries are only dropped by rewriting the file */
+    if (dc_lines > 2 * g_hash_table_size (dc_tbl) + 64)
+    	dcache_compact();
+
+    return;
+}
+
+
+/* Write an entry as one line: size mtime duration fps-num fps-denom width seekable videos audios codec path */
+
+static void dcache_line(FILE *fd, char *path, DcEntry *e)
+{
+    fprintf(fd, "%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%u\t%u\t%u\t%c\t%d\t%d\t%s\t%s\n",
+    		e->size, e->mtime, (guint64) e->duration, e->fr_num, e->fr_denom, e->width,
+    		(e->seekable) ? 'Y' : 'N', e->n_video, e->n_audio, e->codec, path);
+
+    return;
+}
+
+
+/* Rewrite the cache file with only the current entries */
+
+static void dcache_compact()
+{
+    GHashTableIter iter;
+    gpointer k, v;
+    FILE *fd;
+    char *fn, *tmp;
+
+    fn = dcache_fn();
+    tmp = g_strdup_printf ("%s.%08x", fn, g_random_int ());
+
+    if ((fd = g_fopen (tmp, "w")) == NULL)
+    {
+	g_free (tmp);
+	g_free (fn);
+    	return;
+    }
+
+    fputs(DCACHE_HDR, fd);
+    g_hash_table_iter_init (&iter, dc_tbl);
+
+    while (g_hash_table_iter_next (&iter, &k, &v))
+	dcache_line(fd, (char *) k, (DcEntry *) v);
+
+    // Another process may have appended meanwhile - losing that only costs a discovery
+    if (fclose(fd) == 0 && g_rename (tmp, fn) == 0)
+	dc_lines = g_hash_table_size (dc_tbl);
+    else
+	g_unlink (tmp);
+
+    g_free (tmp);
+    g_free (fn);
+
+    return;
+}
+
+
+/* Cache file name, the directory is created if need be */
+
+static char * dcache_fn()
+{
+    gchar *dir, *fn;
+
+    dir = g_build_filename (g_get_user_cache_dir (), DCACHE_DIR, NULL);
+    g_mkdir_with_parents (dir, 0700);
+    fn = g_build_filename (dir, DCACHE_FILE, NULL);
+    g_free (dir);
+
+    return fn;
+}
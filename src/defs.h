@@ -54,6 +54,7 @@
 #include <gdk/gdkquartz.h>
 #endif
 
+#ifdef GTK_MAJOR_VERSION				// Not wanted by the headless engine
 #ifndef AC_COLOURS
 #define AC_COLOURS
 #ifdef MAIN_UI
@@ -73,6 +74,7 @@ extern const GdkRGBA RED1;
 extern const GdkRGBA NIGHT;
 #endif
 #endif
+#endif
 
 
 /* Application Name et al */
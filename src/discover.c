@@ -0,0 +1,397 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Discovery service. Videos are queued and discovered several at once, each
+**		discoverer running asynchronously on the main loop and taking the next video
+**		from the queue as it finishes one, so a slow video does not hold up the rest.
+**		Each result is given to a callback - nothing waits in a main loop of its own.
+**		Videos in the discovery cache are given back straight away (from an idle callback).
+**		A timed out video goes to the back of the queue to be tried again.
+**		If another video is chosen for the same conversion first, the result is not wanted.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**
+*/
+
+
+
+/* Defines */
+
+#define DISC_TIMEOUT 5			// Seconds for one video
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _disc_svc DiscSvc;
+
+typedef struct _disc_req
+{
+    AppData *app_data;
+    char *fn;				/* Full path - the result is dropped if the video has been changed since */
+    char *uri;
+    void (*done)(AppData *, int, void *);	/* Called with TRUE if the video can be converted */
+    void *data;
+} DiscReq;
+
+typedef struct _disc_slot
+{
+    DiscSvc *svc;
+    GstDiscoverer *discoverer;		/* Made when first needed */
+    DiscReq *req;			/* Being discovered, NULL if idle */
+} DiscSlot;
+
+struct _disc_svc
+{
+    GQueue *queue;			/* Waiting for a discoverer */
+    GQueue *known;			/* Found in the cache, waiting to be given back */
+    DiscSlot *slots;
+    int n_slots;			/* Most videos discovered at once */
+    guint idle_id;
+};
+
+
+/* Prototypes */
+
+void * disc_new(int);
+int disc_add(void *, AppData *, char *, void (*)(AppData *, int, void *), void *);
+void disc_free(void *);
+static void disc_next(DiscSvc *);
+static int disc_slot_start(DiscSlot *);
+static void disc_done(DiscReq *, int);
+static int disc_stale(DiscReq *);
+static void disc_req_free(DiscReq *);
+static gboolean disc_known(gpointer);
+static void disc_discovered(GstDiscoverer *, GstDiscovererInfo *, GError *, gpointer);
+
+extern char * video_uri(AppData *, char *);
+extern int video_cached(AppData *);
+extern int video_info_set(AppData *, GstDiscovererInfo *, GError *);
+extern void eng_msg(AppData *, char *, char *);
+extern void eng_status(AppData *, char *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-discover.c ";
+
+
+/* New discovery service, up to n_max videos at once (0 for one per processor) */
+
+void * disc_new(int n_max)
+{
+    DiscSvc *svc;
+    int i;
+
+    if (n_max < 1)
+    	n_max = (int) g_get_num_processors ();
+
+    svc = (DiscSvc *) malloc(sizeof(DiscSvc));
+    memset(svc, 0, sizeof(DiscSvc));
+    svc->queue = g_queue_new ();
+    svc->known = g_queue_new ();
+    svc->n_slots = n_max;
+    svc->slots = (DiscSlot *) malloc(sizeof(DiscSlot) * n_max);
+    memset(svc->slots, 0, sizeof(DiscSlot) * n_max);
+
+    for(i = 0; i < n_max; i++)
+	svc->slots[i].svc = svc;
+
+    return (void *) svc;
+}
+
+
+/* Queue a video for discovery. The callback is not called if FALSE is returned (the video is not valid). */
+
+int disc_add(void *p, AppData *app_data, char *fn, void (*done)(AppData *, int, void *), void *data)
+{
+    DiscSvc *svc;
+    DiscReq *req;
+    char *uri;
+
+    svc = (DiscSvc *) p;
+
+    if ((uri = video_uri(app_data, fn)) == NULL)
+    	return FALSE;
+
+    app_data->video_ok = FALSE;
+
+    req = (DiscReq *) malloc(sizeof(DiscReq));
+    req->app_data = app_data;
+    req->fn = strdup(app_data->video_fn);
+    req->uri = uri;
+    req->done = done;
+    req->data = data;
+
+    if (video_cached(app_data) == TRUE)
+    {
+	g_queue_push_tail (svc->known, req);
+
+	if (svc->idle_id == 0)
+	    svc->idle_id = g_idle_add (disc_known, svc);
+
+	return TRUE;
+    }
+
+    g_queue_push_tail (svc->queue, req);
+    disc_next(svc);
+
+    return TRUE;
+}
+
+
+/* Stop discovery - any videos not yet discovered are dropped without a callback. Not for use in a callback. */
+
+void disc_free(void *p)
+{
+    DiscSvc *svc;
+    DiscSlot *slot;
+    DiscReq *req;
+    int i;
+
+    svc = (DiscSvc *) p;
+
+    if (svc->idle_id != 0)
+	g_source_remove (svc->idle_id);
+
+    for(i = 0; i < svc->n_slots; i++)
+    {
+	slot = &(svc->slots[i]);
+
+	if (slot->discoverer == NULL)
+	    continue;
+
+	gst_discoverer_stop (slot->discoverer);
+	g_object_unref (slot->discoverer);
+
+	if (slot->req != NULL)
+	    g_queue_push_tail (svc->queue, slot->req);
+    }
+
+    while((req = (DiscReq *) g_queue_pop_head (svc->queue)) != NULL)
+	disc_req_free(req);
+
+    while((req = (DiscReq *) g_queue_pop_head (svc->known)) != NULL)
+	disc_req_free(req);
+
+    g_queue_free (svc->queue);
+    g_queue_free (svc->known);
+    free(svc->slots);
+    free(svc);
+
+    return;
+}
+
+
+/* Give queued videos to any idle discoverers */
+
+static void disc_next(DiscSvc *svc)
+{
+    DiscSlot *slot;
+    int i;
+
+    for(i = 0; i < svc->n_slots && ! g_queue_is_empty (svc->queue); i++)
+    {
+	slot = &(svc->slots[i]);
+
+	if (slot->req != NULL)
+	    continue;
+
+	slot->req = (DiscReq *) g_queue_pop_head (svc->queue);
+
+	if (disc_stale(slot->req))
+	{
+	    disc_req_free(slot->req);
+	    slot->req = NULL;
+	    i--;
+	    continue;
+	}
+
+	// A discoverer that cannot start fails its video, the slot is tried again for the next one
+	if (disc_slot_start(slot) == FALSE)
+	{
+	    disc_done(slot->req, FALSE);
+	    slot->req = NULL;
+	    i--;
+	}
+    }
+
+    return;
+}
+
+
+/* Start discovering the video for a slot */
+
+static int disc_slot_start(DiscSlot *slot)
+{
+    AppData *app_data;
+    GError *err = NULL;
+
+    app_data = slot->req->app_data;
+
+    if (slot->discoverer == NULL)
+    {
+	slot->discoverer = gst_discoverer_new (DISC_TIMEOUT * GST_SECOND, &err);
+
+	if (slot->discoverer == NULL)
+	{
+	    sprintf(app_msg_extra, "Error: %s\n", err->message);
+	    g_clear_error (&err);
+	    eng_msg(app_data, "MSG9013", NULL);
+	    eng_status(app_data, "Video error (MSG9013)");
+	    return FALSE;
+	}
+
+	g_signal_connect (slot->discoverer, "discovered", G_CALLBACK (disc_discovered), slot);
+	gst_discoverer_start (slot->discoverer);
+    }
+
+    eng_status(app_data, "Getting Video information, please wait...");
+
+    if (! gst_discoverer_discover_uri_async (slot->discoverer, slot->req->uri))
+    {
+	eng_msg(app_data, "MSG9014", slot->req->uri);
+	eng_status(app_data, "Video error (MSG9014)");
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* Hand back a result */
+
+static void disc_done(DiscReq *req, int ok)
+{
+    AppData *app_data;
+
+    app_data = req->app_data;
+    app_data->video_ok = ok;
+
+    if (ok == TRUE)
+	eng_status(app_data, "Video discovery finished, ready to Convert");
+    else
+	eng_status(app_data, "Video discovery failed");
+
+    if (req->done != NULL)
+	(*req->done)(app_data, ok, req->data);
+
+    disc_req_free(req);
+
+    return;
+}
+
+
+/* The conversion has moved on to another video */
+
+static int disc_stale(DiscReq *req)
+{
+    return (strcmp(req->fn, req->app_data->video_fn) != 0);
+}
+
+
+/* Free a request */
+
+static void disc_req_free(DiscReq *req)
+{
+    free(req->fn);
+    free(req->uri);
+    free(req);
+
+    return;
+}
+
+
+/* Videos found in the cache (idle callback) */
+
+static gboolean disc_known(gpointer data)
+{
+    DiscSvc *svc;
+    DiscReq *req;
+
+    svc = (DiscSvc *) data;
+    svc->idle_id = 0;
+
+    while((req = (DiscReq *) g_queue_pop_head (svc->known)) != NULL)
+    {
+	if (disc_stale(req))
+	    disc_req_free(req);
+	else
+	    disc_done(req, TRUE);
+    }
+
+    return FALSE;
+}
+
+
+/* Callback for a discoverer - a video has been discovered (or failed or timed out) */
+
+static void disc_discovered(GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, gpointer data)
+{
+    DiscSlot *slot;
+    DiscReq *req;
+    int ok;
+
+    slot = (DiscSlot *) data;
+    req = slot->req;
+    slot->req = NULL;
+
+    if (req == NULL)
+    	return;
+
+    if (disc_stale(req))
+    {
+	disc_req_free(req);
+	disc_next(slot->svc);
+	return;
+    }
+
+    req->app_data->discover_retry = FALSE;
+    ok = video_info_set(req->app_data, info, err);
+
+    if (ok == FALSE && req->app_data->discover_retry == TRUE)
+	g_queue_push_tail (slot->svc->queue, req);
+    else
+	disc_done(req, ok);
+
+    disc_next(slot->svc);
+
+    return;
+}
@@ -0,0 +1,830 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Native image encoders used by the frame pool. Each one encodes a raw video
+**		frame into a memory buffer that belongs to the calling worker thread, so any
+**		number of them may run at once. No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	PNG encoder
+**	18-Oct-2026	Very large PNG frames compressed in parts on several threads
+**	18-Oct-2026	BMP writer
+**	18-Oct-2026	Split PNG threads limited to one per processor for the whole process
+**
+*/
+
+
+
+/* Defines */
+
+#define JPG_QUALITY 90			// Same as jpegenc was set to
+#define PNG_LEVEL 6			// Same as pngenc was set to
+#define PNG_SPLIT_MIN (32 * 1024 * 1024)	// Raw frame size (bytes) above which a frame is split (> 4K UHD)
+#define PNG_PART_MIN (4 * 1024 * 1024)	// Least raw data for each part
+#define PNG_WINDOW 32768		// Deflate window, each part starts with the tail of the one before
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <glib.h>
+#include <jpeglib.h>
+#include <png.h>
+#include <zlib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _png_part		// One band of rows of a split PNG frame
+{
+    AppData *app_data;
+    guint8 *data;			/* Raw frame */
+    int stride;
+    gsize row_bytes;
+    int y0, y1;				/* Rows in the part (y1 exclusive) */
+    guchar *filt;			/* Filtered rows for the whole frame */
+    int last;				/* Ends the deflate stream */
+    EncBuf z;				/* Compressed part */
+    uLong adler;			/* Adler-32 of the filtered part */
+    int ok;
+} PngPart;
+
+typedef struct _jpg_err
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jb;				/* Back to the encoder instead of exiting */
+} JpgErr;
+
+
+/* Prototypes */
+
+const char * native_format(AppData *);
+int encode_frame(AppData *, GstSample *, EncBuf *);
+void encode_done(EncBuf *);
+int encode_jpeg(EncBuf *, guint8 *, int, int, int);
+int encode_png(AppData *, EncBuf *, guint8 *, int, int, int);
+int encode_bmp(EncBuf *, guint8 *, int, int, int);
+static int encode_png_split(AppData *, EncBuf *, guint8 *, int, int, int, int);
+static void * png_part_filter(void *);
+static void * png_part_deflate(void *);
+static int png_reserve(int);
+static void png_run_parts(PngPart *, int, void * (*)(void *));
+static void png_filter_row(int, guchar *, guchar *, guchar *, gsize);
+static int png_paeth(int, int, int);
+static void png_put32(EncBuf *, guint32);
+static void png_chunk(EncBuf *, const char *, guchar *, gsize);
+static void jpg_error_exit(j_common_ptr);
+static void png_write_buf(png_structp, png_bytep, png_size_t);
+static void png_flush_buf(png_structp);
+static int enc_copy(EncBuf *, guint8 *, gsize);
+static void enc_reserve(EncBuf *, gsize);
+
+extern const char * output_format(AppData *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-encoders.c ";
+static const int png_strategy_arr[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE, Z_HUFFMAN_ONLY };	// enum png_strategy
+static gint png_helpers = 0;			// Extra split PNG threads running in the process
+
+
+/* Raw format each native encoder takes, or NULL if there is no native encoder for the image type */
+
+const char * native_format(AppData *app_data)
+{
+    switch(app_data->codec_idx)
+    {
+    	case CODEC_JPG:
+    	case CODEC_PNG:
+	    return "RGB";
+    	case CODEC_BMP:
+	    return "BGR";				// Rows are 4 byte aligned, as BMP has them
+    	case CODEC_RAW:
+	    return output_format(app_data);
+	default:
+	    return NULL;
+    }
+}
+
+
+/* Encode a frame from the appsink into the buffer (compressed frames are passed as they are) */
+
+int encode_frame(AppData *app_data, GstSample *sample, EncBuf *out)
+{
+    GstCaps *caps;
+    GstBuffer *buffer;
+    GstMapInfo map;
+    GstVideoInfo info;
+    int r;
+
+    caps = gst_sample_get_caps (sample);
+    buffer = gst_sample_get_buffer (sample);
+
+    if (caps == NULL || buffer == NULL)
+    	return FALSE;
+
+    if (! gst_buffer_map (buffer, &map, GST_MAP_READ))
+    	return FALSE;
+
+    /* Passthrough */
+    if (gst_structure_has_name (gst_caps_get_structure (caps, 0), "image/jpeg"))
+    {
+	r = enc_copy(out, map.data, map.size);
+	gst_buffer_unmap (buffer, &map);
+	return r;
+    }
+
+    if (! gst_video_info_from_caps (&info, caps))
+    {
+	gst_buffer_unmap (buffer, &map);
+	return FALSE;
+    }
+
+    /* BMP is just a header, then the frame is written as it is (unmapped when done) */
+    if (app_data->codec_idx == CODEC_BMP && 
+    	GST_VIDEO_INFO_PLANE_STRIDE (&info, 0) == ((GST_VIDEO_INFO_WIDTH (&info) * 3 + 3) & ~3))
+    {
+	encode_bmp(out, NULL, GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info), 
+		   GST_VIDEO_INFO_PLANE_STRIDE (&info, 0));
+
+	out->body_buf = buffer;
+	out->body_map = map;
+	out->body = map.data;
+	out->body_len = (gsize) GST_VIDEO_INFO_PLANE_STRIDE (&info, 0) * GST_VIDEO_INFO_HEIGHT (&info);
+
+	return TRUE;
+    }
+
+    switch(app_data->codec_idx)
+    {
+    	case CODEC_JPG:
+	    r = encode_jpeg(out, map.data, GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info), 
+	    		    GST_VIDEO_INFO_PLANE_STRIDE (&info, 0));
+	    break;
+    	case CODEC_PNG:
+	    r = encode_png(app_data, out, map.data, GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info), 
+	    		   GST_VIDEO_INFO_PLANE_STRIDE (&info, 0));
+	    break;
+    	case CODEC_BMP:
+	    r = encode_bmp(out, map.data, GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info), 
+	    		   GST_VIDEO_INFO_PLANE_STRIDE (&info, 0));
+	    break;
+	default:
+	    r = FALSE;
+	    break;
+    }
+
+    gst_buffer_unmap (buffer, &map);
+
+    return r;
+}
+
+
+/* Finished with the frame */
+
+void encode_done(EncBuf *out)
+{
+    if (out->body_buf != NULL)
+	gst_buffer_unmap (out->body_buf, &(out->body_map));
+
+    out->body_buf = NULL;
+    out->body = NULL;
+    out->body_len = 0;
+
+    return;
+}
+
+
+/* BMP (BGR in) - a negative height means the rows are top down, as the frame has them */
+/* With no data only the headers are set, the frame rows are written after them as they are */
+
+int encode_bmp(EncBuf *out, guint8 *data, int width, int height, int stride)
+{
+    guint32 hdr[13];
+    guint32 img_sz, row_sz;
+    int y;
+
+    row_sz = (guint32) ((width * 3 + 3) & ~3);
+    img_sz = row_sz * height;
+
+    hdr[0] = GUINT32_TO_LE (14 + 40 + img_sz);		// File size (after 'BM')
+    hdr[1] = 0;						// Reserved
+    hdr[2] = GUINT32_TO_LE (14 + 40);			// Offset to the pixels
+    hdr[3] = GUINT32_TO_LE (40);			// BITMAPINFOHEADER
+    hdr[4] = GUINT32_TO_LE ((guint32) width);
+    hdr[5] = GUINT32_TO_LE ((guint32) -height);		// Top down
+    hdr[6] = GUINT32_TO_LE (1 | (24 << 16));		// Planes, bits per pixel
+    hdr[7] = 0;						// BI_RGB
+    hdr[8] = GUINT32_TO_LE (img_sz);
+    hdr[9] = GUINT32_TO_LE (2835);			// 72 dpi
+    hdr[10] = GUINT32_TO_LE (2835);
+    hdr[11] = 0;					// Palette
+    hdr[12] = 0;
+
+    enc_reserve(out, 14 + 40 + ((data != NULL) ? img_sz : 0));
+    out->data[0] = 'B';
+    out->data[1] = 'M';
+    memcpy(out->data + 2, hdr, sizeof(hdr));
+    out->len = 14 + 40;
+
+    // Odd stride - copy the rows with BMP padding
+    if (data != NULL)
+    {
+	for(y = 0; y < height; y++)
+	{
+	    memcpy(out->data + out->len, data + (gsize) y * stride, width * 3);
+	    memset(out->data + out->len + width * 3, 0, row_sz - width * 3);
+	    out->len += row_sz;
+	}
+    }
+
+    return TRUE;
+}
+
+
+/* JPEG (RGB in) - libjpeg(-turbo) writes straight into the worker buffer */
+
+int encode_jpeg(EncBuf *out, guint8 *data, int width, int height, int stride)
+{
+    struct jpeg_compress_struct cinfo;
+    JpgErr jerr;
+    unsigned char * volatile mem;
+    unsigned long mem_sz;
+    JSAMPROW row;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpg_error_exit;
+
+    if (setjmp(jerr.jb))
+    {
+	jpeg_destroy_compress(&cinfo);
+
+	if (mem != out->data)
+	    free(mem);
+
+	return FALSE;
+    }
+
+    mem = out->data;
+    jpeg_create_compress(&cinfo);
+
+    // If the buffer is too small libjpeg allocates a bigger one and leaves ours alone
+    mem_sz = (unsigned long) out->size;
+    jpeg_mem_dest(&cinfo, (unsigned char **) &mem, &mem_sz);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, JPG_QUALITY, TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while(cinfo.next_scanline < cinfo.image_height)
+    {
+	row = (JSAMPROW) (data + (gsize) cinfo.next_scanline * stride);
+	jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    if (mem != out->data)
+    {
+	free(out->data);
+	out->data = mem;
+	out->size = mem_sz;
+    }
+
+    out->len = mem_sz;
+
+    return TRUE;
+}
+
+
+/* PNG (RGB in) - libpng with the filter and zlib settings chosen by the user */
+
+int encode_png(AppData *app_data, EncBuf *out, guint8 *data, int width, int height, int stride)
+{
+    const int filter_arr[] = { PNG_ALL_FILTERS, PNG_FILTER_NONE, PNG_FILTER_SUB, 
+    			       PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH };
+    png_structp png_ptr;
+    png_infop info_ptr;
+    gsize raw;
+    int y, n_parts, extra, ok;
+
+    out->len = 0;
+
+    /* Very large frames take too long on one thread, so compress them in parts. The extra */
+    /* threads for the whole process are limited to one per processor, so a full pool does */
+    /* not start one set for every worker - a frame gets what is free, or goes on one thread. */
+    raw = (gsize) width * 3 * height;
+    n_parts = (int) MIN ((gsize) g_get_num_processors (), raw / PNG_PART_MIN);
+
+    if (raw >= PNG_SPLIT_MIN && n_parts > 1 && (extra = png_reserve(n_parts - 1)) > 0)
+    {
+	ok = encode_png_split(app_data, out, data, width, height, stride, extra + 1);
+	g_atomic_int_add (&png_helpers, -extra);
+	return ok;
+    }
+
+    if ((png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)) == NULL)
+    	return FALSE;
+
+    if ((info_ptr = png_create_info_struct(png_ptr)) == NULL)
+    {
+	png_destroy_write_struct(&png_ptr, NULL);
+    	return FALSE;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+    {
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return FALSE;
+    }
+
+    png_set_write_fn(png_ptr, (png_voidp) out, png_write_buf, png_flush_buf);
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB, 
+    		 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    // A single filter avoids trying all five on every row, which is most of the cost at low levels
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filter_arr[app_data->png_filter]);
+    png_set_compression_level(png_ptr, (app_data->png_level > 0) ? app_data->png_level : PNG_LEVEL);
+    png_set_compression_strategy(png_ptr, png_strategy_arr[app_data->png_strategy]);
+
+    png_write_info(png_ptr, info_ptr);
+
+    for(y = 0; y < height; y++)
+	png_write_row(png_ptr, (png_bytep) (data + (gsize) y * stride));
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return TRUE;
+}
+
+
+/* 
+    Split PNG (as pigz does) - the frame is cut into bands of rows and each band is filtered
+    and then deflated on its own thread. Every band but the last ends on a byte boundary
+    (sync flush) and starts with the tail of the band before as its dictionary, so the bands
+    simply join up into one zlib stream in a single IDAT. The Adler-32 is combined from
+    the bands. libpng cannot write a stream made like this, so the PNG is put together here.
+*/
+
+static int encode_png_split(AppData *app_data, EncBuf *out, guint8 *data, int width, int height, 
+			    int stride, int n_parts)
+{
+    const guchar sig[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    PngPart *parts;
+    guchar ihdr[13];
+    guchar *filt;
+    gsize row_bytes, idat_len, pos;
+    uLong adler;
+    int i, level, ok;
+
+    row_bytes = (gsize) width * 3;
+    filt = (guchar *) malloc((row_bytes + 1) * height);
+    parts = (PngPart *) malloc(sizeof(PngPart) * n_parts);
+
+    if (filt == NULL || parts == NULL)
+    {
+	free(filt);
+	free(parts);
+	return FALSE;
+    }
+
+    memset(parts, 0, sizeof(PngPart) * n_parts);
+
+    for(i = 0; i < n_parts; i++)
+    {
+	parts[i].app_data = app_data;
+	parts[i].data = data;
+	parts[i].stride = stride;
+	parts[i].row_bytes = row_bytes;
+	parts[i].y0 = (int) (((gint64) height * i) / n_parts);
+	parts[i].y1 = (int) (((gint64) height * (i + 1)) / n_parts);
+	parts[i].filt = filt;
+	parts[i].last = (i == n_parts - 1);
+	parts[i].ok = TRUE;
+    }
+
+    /* Filter first - each band needs the filtered tail of the band before it */
+    png_run_parts(parts, n_parts, png_part_filter);
+    png_run_parts(parts, n_parts, png_part_deflate);
+
+    ok = TRUE;
+    idat_len = 2 + 4;
+    adler = adler32(0L, Z_NULL, 0);
+
+    for(i = 0; i < n_parts; i++)
+    {
+	ok = (ok && parts[i].ok);
+	idat_len += parts[i].z.len;
+	adler = adler32_combine(adler, parts[i].adler, (z_off_t) ((parts[i].y1 - parts[i].y0) * (row_bytes + 1)));
+    }
+
+    if (ok == TRUE)
+    {
+	/* Signature and header */
+	out->len = 0;
+	enc_reserve(out, sizeof(sig) + 25 + idat_len + 12 + 12);
+	memcpy(out->data, sig, sizeof(sig));
+	out->len = sizeof(sig);
+
+	ihdr[0] = (width >> 24) & 0xff; ihdr[1] = (width >> 16) & 0xff; ihdr[2] = (width >> 8) & 0xff; ihdr[3] = width & 0xff;
+	ihdr[4] = (height >> 24) & 0xff; ihdr[5] = (height >> 16) & 0xff; ihdr[6] = (height >> 8) & 0xff; ihdr[7] = height & 0xff;
+	ihdr[8] = 8;			// Bit depth
+	ihdr[9] = 2;			// RGB
+	ihdr[10] = 0;			// Deflate
+	ihdr[11] = 0;			// Adaptive filtering (per row filter type)
+	ihdr[12] = 0;			// Not interlaced
+	png_chunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+	/* IDAT - zlib header, the bands, Adler-32 */
+	png_put32(out, (guint32) idat_len);
+	pos = out->len;
+	memcpy(out->data + out->len, "IDAT", 4);
+	out->len += 4;
+
+	level = (app_data->png_level > 0) ? app_data->png_level : PNG_LEVEL;
+	out->data[out->len++] = 0x78;
+	out->data[out->len++] = (level == 1) ? 0x01 : (level < 6) ? 0x5e : (level == 6) ? 0x9c : 0xda;
+
+	for(i = 0; i < n_parts; i++)
+	{
+	    memcpy(out->data + out->len, parts[i].z.data, parts[i].z.len);
+	    out->len += parts[i].z.len;
+	}
+
+	png_put32(out, (guint32) adler);
+	png_put32(out, (guint32) crc32(crc32(0L, Z_NULL, 0), out->data + pos, out->len - pos));
+
+	png_chunk(out, "IEND", NULL, 0);
+    }
+
+    for(i = 0; i < n_parts; i++)
+	free(parts[i].z.data);
+
+    free(filt);
+    free(parts);
+
+    return ok;
+}
+
+
+/* Reserve up to 'want' extra threads from the process wide limit, returns the number given */
+
+static int png_reserve(int want)
+{
+    gint cur, n;
+
+    do
+    {
+	cur = g_atomic_int_get (&png_helpers);
+	n = MIN(want, (int) g_get_num_processors () - cur);
+
+	if (n <= 0)
+	    return 0;
+    } while (! g_atomic_int_compare_and_exchange (&png_helpers, cur, cur + n));
+
+    return n;
+}
+
+
+/* Run a function on every band at once and wait for them all (any thread that can't start runs here) */
+
+static void png_run_parts(PngPart *parts, int n_parts, void * (*fn)(void *))
+{
+    pthread_t *tids;
+    int i, n_started;
+
+    tids = (pthread_t *) malloc(sizeof(pthread_t) * n_parts);
+    n_started = 0;
+
+    for(i = 0; i < n_parts; i++)
+    {
+	if (tids != NULL && i < n_parts - 1 && i == n_started && 
+	    pthread_create(&(tids[i]), NULL, fn, (void *) &(parts[i])) == 0)
+	    n_started++;
+	else
+	    (*fn)((void *) &(parts[i]));
+    }
+
+    for(i = 0; i < n_started; i++)
+	pthread_join(tids[i], NULL);
+
+    free(tids);
+
+    return;
+}
+
+
+/* Filter the rows of a band (the row above the band is still raw, so any band can go first) */
+
+static void * png_part_filter(void *arg)
+{
+    PngPart *part;
+    guchar *trial[5];
+    guchar *row, *prev, *best;
+    gsize sum, best_sum;
+    int y, f, i, filter;
+
+    part = (PngPart *) arg;
+    filter = part->app_data->png_filter;
+
+    // Adaptive tries every filter type on the row and keeps the smallest (as libpng does)
+    if (filter == PNG_FLT_ADAPTIVE)
+    {
+	for(f = 0; f < 5; f++)
+	    trial[f] = (guchar *) malloc(part->row_bytes + 1);
+    }
+
+    for(y = part->y0; y < part->y1; y++)
+    {
+	row = part->data + (gsize) y * part->stride;
+	prev = (y > 0) ? part->data + (gsize) (y - 1) * part->stride : NULL;
+
+	if (filter != PNG_FLT_ADAPTIVE)
+	{
+	    png_filter_row(filter - 1, row, prev, part->filt + (gsize) y * (part->row_bytes + 1), part->row_bytes);
+	    continue;
+	}
+
+	best = NULL;
+	best_sum = 0;
+
+	for(f = 0; f < 5; f++)
+	{
+	    png_filter_row(f, row, prev, trial[f], part->row_bytes);
+
+	    for(i = 1, sum = 0; i <= part->row_bytes; i++)
+		sum += abs((signed char) trial[f][i]);
+
+	    if (best == NULL || sum < best_sum)
+	    {
+		best = trial[f];
+		best_sum = sum;
+	    }
+	}
+
+	memcpy(part->filt + (gsize) y * (part->row_bytes + 1), best, part->row_bytes + 1);
+    }
+
+    if (filter == PNG_FLT_ADAPTIVE)
+    {
+	for(f = 0; f < 5; f++)
+	    free(trial[f]);
+    }
+
+    return NULL;
+}
+
+
+/* Deflate a band as a raw piece of the frame's zlib stream */
+
+static void * png_part_deflate(void *arg)
+{
+    PngPart *part;
+    AppData *app_data;
+    z_stream strm;
+    guchar *in;
+    gsize len, dict_len;
+    int r;
+
+    part = (PngPart *) arg;
+    app_data = part->app_data;
+    in = part->filt + (gsize) part->y0 * (part->row_bytes + 1);
+    len = (gsize) (part->y1 - part->y0) * (part->row_bytes + 1);
+    part->adler = adler32(adler32(0L, Z_NULL, 0), in, (uInt) len);
+
+    memset(&strm, 0, sizeof(z_stream));
+
+    if (deflateInit2(&strm, (app_data->png_level > 0) ? app_data->png_level : PNG_LEVEL, Z_DEFLATED, -15, 8, 
+		     png_strategy_arr[app_data->png_strategy]) != Z_OK)
+    {
+	part->ok = FALSE;
+	return NULL;
+    }
+
+    if (part->y0 > 0)
+    {
+	dict_len = MIN ((gsize) PNG_WINDOW, (gsize) part->y0 * (part->row_bytes + 1));
+	deflateSetDictionary(&strm, in - dict_len, (uInt) dict_len);
+    }
+
+    // Room for the worst case plus the sync flush marker
+    enc_reserve(&(part->z), deflateBound(&strm, len) + 16);
+
+    strm.next_in = in;
+    strm.avail_in = (uInt) len;
+    strm.next_out = part->z.data;
+    strm.avail_out = (uInt) part->z.size;
+
+    r = deflate(&strm, (part->last == TRUE) ? Z_FINISH : Z_SYNC_FLUSH);
+
+    if ((part->last == TRUE && r != Z_STREAM_END) || (part->last == FALSE && r != Z_OK) || strm.avail_in != 0)
+	part->ok = FALSE;
+
+    part->z.len = part->z.size - strm.avail_out;
+    deflateEnd(&strm);
+
+    return NULL;
+}
+
+
+/* Filter one row (type 0 - 4) into out - the filter type byte and then the filtered bytes */
+
+static void png_filter_row(int type, guchar *row, guchar *prev, guchar *out, gsize n)
+{
+    gsize i;
+    int a, b, c;
+
+    out[0] = (guchar) type;
+    out++;
+
+    for(i = 0; i < n; i++)
+    {
+	a = (i >= 3) ? row[i - 3] : 0;			// Left (3 bytes per pixel)
+	b = (prev != NULL) ? prev[i] : 0;		// Above
+	c = (i >= 3 && prev != NULL) ? prev[i - 3] : 0;	// Above left
+
+	switch(type)
+	{
+	    case 0:
+		out[i] = row[i];
+		break;
+	    case 1:
+		out[i] = (guchar) (row[i] - a);
+		break;
+	    case 2:
+		out[i] = (guchar) (row[i] - b);
+		break;
+	    case 3:
+		out[i] = (guchar) (row[i] - ((a + b) >> 1));
+		break;
+	    default:
+		out[i] = (guchar) (row[i] - png_paeth(a, b, c));
+		break;
+	}
+    }
+
+    return;
+}
+
+
+/* Paeth predictor */
+
+static int png_paeth(int a, int b, int c)
+{
+    int p, pa, pb, pc;
+
+    p = a + b - c;
+    pa = abs(p - a);
+    pb = abs(p - b);
+    pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+    	return a;
+    else if (pb <= pc)
+    	return b;
+    else
+    	return c;
+}
+
+
+/* Big endian 32 bit value (room already reserved) */
+
+static void png_put32(EncBuf *out, guint32 v)
+{
+    out->data[out->len++] = (v >> 24) & 0xff;
+    out->data[out->len++] = (v >> 16) & 0xff;
+    out->data[out->len++] = (v >> 8) & 0xff;
+    out->data[out->len++] = v & 0xff;
+
+    return;
+}
+
+
+/* Whole PNG chunk - length, type, data and CRC (room already reserved) */
+
+static void png_chunk(EncBuf *out, const char *type, guchar *data, gsize len)
+{
+    gsize pos;
+
+    png_put32(out, (guint32) len);
+    pos = out->len;
+    memcpy(out->data + out->len, type, 4);
+    out->len += 4;
+
+    if (len > 0)
+    {
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+    }
+
+    png_put32(out, (guint32) crc32(crc32(0L, Z_NULL, 0), out->data + pos, len + 4));
+
+    return;
+}
+
+
+/* libpng output goes on the end of the worker buffer */
+
+static void png_write_buf(png_structp png_ptr, png_bytep data, png_size_t len)
+{
+    EncBuf *out;
+
+    out = (EncBuf *) png_get_io_ptr(png_ptr);
+    enc_reserve(out, out->len + len);
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+
+    return;
+}
+
+
+/* Nothing to flush in memory */
+
+static void png_flush_buf(png_structp png_ptr)
+{
+    return;
+}
+
+
+/* libjpeg error - report it and return to the encoder */
+
+static void jpg_error_exit(j_common_ptr cinfo)
+{
+    JpgErr *err;
+
+    err = (JpgErr *) cinfo->err;
+    (*cinfo->err->output_message) (cinfo);
+    longjmp(err->jb, 1);
+}
+
+
+/* Compressed frame - just copy */
+
+static int enc_copy(EncBuf *out, guint8 *data, gsize len)
+{
+    enc_reserve(out, len);
+    memcpy(out->data, data, len);
+    out->len = len;
+
+    return TRUE;
+}
+
+
+/* Make sure the buffer can hold len bytes (it is kept for the next frame) */
+
+static void enc_reserve(EncBuf *out, gsize len)
+{
+    if (out->size >= len)
+    	return;
+
+    // Grow by at least half again, as the PNG encoder adds to it a piece at a time
+    if (len < out->size + out->size / 2)
+    	len = out->size + out->size / 2;
+
+    out->data = (guchar *) realloc(out->data, len);
+    out->size = len;
+
+    return;
+}
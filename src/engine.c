@@ -0,0 +1,2049 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Conversion engine - set up a gstreamer pipeline, watch it and discover video details.
+**		There is no GTK in here so that it can be driven by the GUI or the command line.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	24-Jun-2022	Initial code (convert.c)
+**	18-Oct-2026	Separated from the user interface
+**	18-Oct-2026	Frame probe replaces videorate for every nth frame
+**	18-Oct-2026	Sampler seeks past long gaps between selected frames
+**	18-Oct-2026	Decoder skips non-reference frames that can't be wanted
+**	18-Oct-2026	Output width - reduced resolution decoding and scale before conversion
+**	18-Oct-2026	MJPEG passthrough to JPG files
+**	18-Oct-2026	JPG frames encoded by a pool of threads from an appsink
+**	18-Oct-2026	BMP written by the frame pool instead of gdkpixbufsink
+**	18-Oct-2026	RAW frame dump
+**	18-Oct-2026	Sharded output directories
+**	18-Oct-2026	Striped output directories
+**	18-Oct-2026	Discovery cache
+**	18-Oct-2026	Discovery parts shared with the discovery service
+**	18-Oct-2026	Frame numbers and times from the container frame index
+**	18-Oct-2026	Seeks start on the keyframe given by the frame index
+**	18-Oct-2026	Several time ranges in one pass with segment seeks
+**	18-Oct-2026	JPEG passthrough only for the video stream, not cover art
+**	18-Oct-2026	Frame index read when a conversion starts, not by discovery
+**	18-Oct-2026	A failed first seek ends the conversion
+**	18-Oct-2026	MP4 frame index for every conversion, Matroska scan only when it is used
+**
+*/
+
+
+
+/* Defines */
+#define MAX_RETRY 3
+#define SAMPLE_SEEK_COST 15		// Flushing seek overhead, counted as frames decoded
+#define SKIP_MARGIN 32			// Frames before a target to decode in full (covers B-frame reordering)
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>  
+#include <stdlib.h>  
+#include <limits.h>  
+#include <errno.h>  
+#include <string.h>  
+#include <libgen.h>  
+#ifndef __linux__
+#include <windows.h>  
+#endif
+#include <gst/gst.h>
+#include <gst/video/videooverlay.h>
+#include <gst/video/video-format.h>
+#include <gst/pbutils/pbutils.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+#include <inttypes.h>
+
+
+/* Prototypes */
+
+int run_conversion(AppData *);
+int validate_period(AppData *);
+int get_video_data(AppData *, char *);
+char * video_uri(AppData *, char *);
+int video_cached(AppData *);
+int video_info_set(AppData *, GstDiscovererInfo *, GError *);
+void video_index(AppData *, int);
+int setup_gst_pipeline(AppData *);
+int set_elements(AppData *);
+int link_pipeline(AppData *);
+int start_pipeline(AppData *, int);
+int set_pipeline_state(AppData *, GstState);
+void end_conversion(AppData *, int);
+int create_element(GstElement **, const char *, const char *, AppData *);
+GstBusSyncReply bus_sync_handler (GstBus*, GstMessage*, gpointer);
+gboolean bus_message_watch (GstBus *, GstMessage *, gpointer);
+int send_seek_event(AppData *);
+static int seek_frame(AppData *, guint64, GstClockTime);
+static int seek_range(AppData *);
+static int range_frame(AppData *, guint64);
+guint frames_to_convert(AppData *);
+void calc_duration(AppData *, int, int *);
+int get_msd(gint64);
+GstClockTime frame_time(AppData *, guint64);
+guint64 time_frame(AppData *, GstClockTime);
+guint64 stream_frame(AppData *, GstClockTime);
+void eng_msg(AppData *, char *, char *);
+void eng_status(AppData *, char *);
+static void cb_newpad (GstElement *, GstPad *, gpointer);
+static GstPadProbeReturn frame_probe (GstPad *, GstPadProbeInfo *, gpointer);
+static GstPadProbeReturn sample_frame (AppData *, GstBuffer *, guint64);
+static gboolean sample_seek (gpointer);
+static void decode_policy (AppData *, guint64);
+static void cb_element_added (GstBin *, GstBin *, GstElement *, gpointer);
+static gboolean cb_autoplug_continue (GstElement *, GstPad *, GstCaps *, gpointer);
+static int branch_linked(AppData *);
+static void on_discovered_cb (GstDiscoverer *, GstDiscovererInfo *, GError *, gpointer);
+static void video_info_text (AppData *);
+static void on_start_cb (GstDiscoverer *, gpointer);
+static void on_finished_cb (GstDiscoverer *, gpointer);
+
+extern void log_msg(char*, char *);
+extern char * app_msg_text(char*, char *);
+extern void strlower(char *, char *);
+extern int check_file(char *);
+extern const char * native_format(AppData *);
+extern int pool_start(AppData *);
+extern void pool_abort(AppData *);
+extern int pool_stop(AppData *, int);
+extern int dcache_get(AppData *);
+extern void dcache_put(AppData *, int, int, const char *);
+extern int findex_load(AppData *, int);
+extern guint64 findex_peek(AppData *);
+extern void findex_free(AppData *);
+extern guint64 findex_count(AppData *);
+extern GstClockTime findex_time(AppData *, guint64);
+extern int findex_frame(AppData *, GstClockTime, int, guint64 *);
+extern guint64 findex_keys(AppData *);
+extern int findex_key(AppData *, guint64, guint64 *, GstClockTime *);
+
+
+/* Typedefs */
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-engine.c ";
+guintptr video_window_handle = 0;
+
+
+/* Set up the pipeline for the user data already collected and start it */
+
+int run_conversion(AppData *app_data)
+{  
+    /* Frame index - exact progress for any conversion (MP4), Matroska only if it can be used for seeks */
+    video_index(app_data, (app_data->seek_index == TRUE || app_data->interval_type == 2 || app_data->interval_type == 3 ||
+			   (app_data->interval_type == 1 && app_data->frame_interval > 1)));
+
+    /* Conversion pipeline */
+    if (setup_gst_pipeline(app_data) == FALSE)
+    	return FALSE;
+
+    /* Link all the elements */
+    if (link_pipeline(app_data) == FALSE)
+	return FALSE;
+
+    /* Encoder threads for the appsink */
+    if (app_data->gst_objs.a_sink)
+    {
+	if (pool_start(app_data) == FALSE)
+	    return FALSE;
+    }
+
+    /* Start pipeline */
+    if (start_pipeline(app_data, TRUE) == FALSE)
+	return FALSE;
+
+    return TRUE;
+}
+
+
+/* Check that time period conversion is valid */
+
+int validate_period(AppData *app_data)
+{  
+    gint64 segment_length;
+    GstClockTime stop;
+    gint res;
+    const char *dir_msg = "Duration extends beyond the video length. Continue (Truncated)?";
+    int mpx;
+
+    /* Check seekable */
+    if (! app_data->seekable)
+    {
+	eng_msg(app_data, "MSG0010", NULL);
+	return FALSE;
+    }
+
+    /* Time ranges are in order, so only the last one can start or finish past the end */
+    if (app_data->n_ranges > 0)
+    {
+	if (app_data->ranges[(app_data->n_ranges - 1) * 2] > app_data->video_duration)
+	{
+	    eng_msg(app_data, "MSG0011", NULL);
+	    return FALSE;
+	}
+
+	stop = app_data->ranges[app_data->n_ranges * 2 - 1];
+
+	// The seek stops at the end anyway
+	if (stop == GST_CLOCK_TIME_NONE || stop <= app_data->video_duration || app_data->cb.query == NULL)
+	    return TRUE;
+
+	return (*app_data->cb.query)((char *) dir_msg, NULL, app_data->cb.data);
+    }
+
+    /* Start */
+    if (app_data->interval_type == 3)
+    	mpx = 60;
+    else
+    	mpx = 1;
+
+    if ((app_data->time_start * mpx * GST_SECOND) > app_data->video_duration)
+    {
+	eng_msg(app_data, "MSG0011", NULL);
+	return FALSE;
+    }
+
+    /* Duration */
+    segment_length = (app_data->time_start + app_data->time_duration) * GST_SECOND;
+
+    if (app_data->interval_type == 3)
+    	segment_length *= 60;
+
+    if (segment_length > app_data->video_duration)
+    {
+	/* No one to ask means truncate */
+	if (app_data->cb.query != NULL)
+	    res = (*app_data->cb.query)((char *) dir_msg, NULL, app_data->cb.data);
+	else
+	    res = TRUE;
+
+	if (res == FALSE)
+	    return FALSE;
+	else
+	    app_data->time_duration = 0;
+    }
+
+    return TRUE;
+}
+
+
+/* 
+    Setup the gst pipeline and start conversion
+
+    ** Conversion pipeline **
+
+    | Filesrc | -> | Decodebin |-> | VideoConvert | Image Encoder | Multifilesink location=xx%05d.(jpg, png, bmp)
+
+    OR
+
+    | Filesrc | -> | Decodebin |-> | VideoRate | VideoConvert | Image Encoder | Multifilesink location=xx%05d.(jpg, png, bmp)
+
+    OR
+
+    | Filesrc | -> | Decodebin |-> | VideoConvert | Capsfilter (RGB, BGR) | Appsink -> frame pool threads (native encoders)
+*/
+
+int setup_gst_pipeline(AppData *app_data)
+{  
+    /* GST setup */
+    if (!set_elements(app_data))
+	return FALSE;
+
+    return TRUE;
+}
+
+
+/* Create pipeline and conversion elements */
+
+int set_elements(AppData *app_data)
+{
+    const char *codec_selection_arr[] = { "JPG", "PNG", "PNM", "BMP", "RAW" };
+    const char *encoder_arr[] = { "jpegenc", "pngenc", "pnmenc", "", "" };
+    const int codec_max = 5;
+    int codec_idx, mpx;
+    char lwr[4];
+    const char *dir;
+
+    /* Initial */
+    memset(&(app_data->gst_objs), 0, sizeof(app_gst_objs));
+
+    // Determine which image encoder to use 
+    // (JPG, PNG, BMP and RAW are done natively by the frame pool, others by a gst encoder factory)
+
+    codec_idx = 0;
+
+    for(codec_idx = 0; codec_idx < codec_max; codec_idx++)
+    {
+    	if (strcmp(app_data->image_type, codec_selection_arr[codec_idx]) == 0)
+	    break;
+    }
+
+    if (codec_idx >= codec_max)
+    {
+	eng_msg(app_data, "MSG0001", "Image Type");
+    	return FALSE;
+    }
+
+    app_data->codec_idx = codec_idx;
+
+    // Only the frame pool can write separate image files to more than one directory
+    if (app_data->n_out_dirs > 1 && (native_format(app_data) == NULL || codec_idx == CODEC_RAW))
+    {
+	eng_msg(app_data, "MSG0001", "Output Location (one directory only for this Image Type)");
+    	return FALSE;
+    }
+
+    /* Create factories */
+    if (! create_element(&(app_data->gst_objs.file_src), "filesrc", "video", app_data))
+    	return FALSE;
+
+    if (! create_element(&(app_data->gst_objs.v_decode), "decodebin", "v_decode", app_data))
+    	return FALSE;
+
+    g_signal_connect (app_data->gst_objs.v_decode, "pad-added", G_CALLBACK (cb_newpad), app_data);
+
+    // Scale down before colour conversion so that only the small image is converted and encoded
+    if (app_data->out_width > 0)
+    {
+	if (! create_element(&(app_data->gst_objs.v_scale), "videoscale", "v_scale", app_data))
+	    return FALSE;
+
+	if (! create_element(&(app_data->gst_objs.v_filter), "capsfilter", "v_filter", app_data))
+	    return FALSE;
+    }
+
+    if (! create_element(&(app_data->gst_objs.v_convert), "videoconvert", "v_convert", app_data))
+    	return FALSE;
+
+    if (native_format(app_data) != NULL)
+    {
+	// Native encoders are run by a pool of threads on frames taken from an appsink
+	if (! create_element(&(app_data->gst_objs.v_caps), "capsfilter", "v_caps", app_data))
+	    return FALSE;
+
+	if (! create_element(&(app_data->gst_objs.a_sink), "appsink", "app_sink", app_data))
+	    return FALSE;
+    }
+    else
+    {
+	if (! create_element(&(app_data->gst_objs.encoder), encoder_arr[codec_idx], "encoder", app_data))
+	    return FALSE;
+
+	if (! create_element(&(app_data->gst_objs.mf_sink), "multifilesink", "file_sink", app_data))
+	    return FALSE;
+    }
+
+    // MJPEG video can go straight to JPG files with no decode and re-encode (jpegparse is optional)
+    if (codec_idx == CODEC_JPG && app_data->out_width == 0)
+    {
+	app_data->gst_objs.v_parse = gst_element_factory_make ("jpegparse", "v_parse");
+
+	if (app_data->gst_objs.v_parse)
+	    g_signal_connect (app_data->gst_objs.v_decode, "autoplug-continue", 
+			      G_CALLBACK (cb_autoplug_continue), app_data);
+    }
+
+    /* Create the pipeline */
+    app_data->c_pipeline = gst_pipeline_new ("video_convert");
+
+    if (!app_data->c_pipeline)
+    {
+	eng_msg(app_data, "MSG0009", NULL);
+        return FALSE;
+    }
+
+    g_signal_connect (app_data->c_pipeline, "deep-element-added", G_CALLBACK (cb_element_added), app_data);
+
+    /* Populate the gst elements as required */
+    g_object_set (app_data->gst_objs.file_src, "location", app_data->video_fn, NULL);
+
+    app_data->filenm_tmpl = (char *) malloc(strlen(app_data->output_dir) + strlen(app_data->img_prefix) + 40);
+    strlower((char *) codec_selection_arr[codec_idx], lwr);
+
+    // Striped - the directory is chosen for each image by the frame pool, so it is left in the template
+    if (app_data->n_out_dirs > 1)
+	dir = "%s";
+    else
+	dir = app_data->output_dir;
+
+    // Sharded - two directory levels, each of fan-out entries (eg. dir/000/123/Image-0000123456.jpg)
+    if (app_data->shard_fanout > 1)
+    {
+	int w;
+
+	w = snprintf(NULL, 0, "%d", app_data->shard_fanout - 1);
+	sprintf(app_data->filenm_tmpl, "%s/%%0%du/%%0%du/%s%%010d.%s", dir, w, w, app_data->img_prefix, lwr);
+    }
+    else
+    {
+	sprintf(app_data->filenm_tmpl, "%s/%s%%010d.%s", dir, app_data->img_prefix, lwr);
+    }
+
+    if (app_data->gst_objs.mf_sink)
+	g_object_set (app_data->gst_objs.mf_sink, "location", app_data->filenm_tmpl, "post-messages", TRUE, 
+						  "index", (gint) app_data->start_index, NULL);
+
+    if (app_data->gst_objs.a_sink)
+    {
+	GstCaps *caps;
+
+	caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, native_format(app_data), NULL);
+	g_object_set (app_data->gst_objs.v_caps, "caps", caps, NULL);
+	gst_caps_unref (caps);
+	g_object_set (app_data->gst_objs.a_sink, "sync", (gboolean) FALSE, NULL);
+    }
+
+    switch ((app_data->gst_objs.encoder) ? codec_idx : -1)
+    {
+    	case -1:
+	    break;									// native encoder
+    	case 0:
+	    g_object_set (app_data->gst_objs.encoder, "quality", (gint) 90, NULL);		// jpg
+	    break;
+    	case 1:
+	    g_object_set (app_data->gst_objs.encoder, "compression-level", (guint) 6, NULL);	// png
+	    break;
+    	case 2:
+	    g_object_set (app_data->gst_objs.encoder, "ascii", (gboolean) FALSE, NULL);		// pnm -> bmp
+	    break;
+    	case 3:
+	    break; 										// bmp
+    	default:
+	    return FALSE;
+    }
+
+    // Every nth frame is picked in the frame probe, straight after decoding, so the
+    // frames not wanted are never colour converted or encoded
+    if (app_data->seg_no == 0)
+    {
+	app_data->frm_first = 0;
+	app_data->frm_last = G_MAXUINT64;
+    }
+
+    // Sparse frames may be quicker to reach by seeking than by decoding everything in between
+    app_data->sampler = (app_data->interval_type == 1 && app_data->frame_interval > 1 && 
+    			 app_data->seekable && app_data->fr_num > 0 && app_data->fr_denom > 0);
+
+    // With the keyframes known, a seek goes to the one before the first frame wanted and the
+    // frames are numbered from the index, so a time period is cut to exact frames as a segment is
+    app_data->key_seek = (findex_keys(app_data) > 0 && app_data->seekable && app_data->interval_type != 4 &&
+    			  (app_data->seg_no > 0 || app_data->sampler || app_data->interval_type >= 2));
+
+    if (app_data->key_seek == TRUE && app_data->seg_no == 0 && app_data->n_ranges > 0)
+    {
+	// From the first range to the last, range_frame() has the gaps
+	app_data->frm_first = time_frame(app_data, app_data->ranges[0]);
+
+	if (app_data->ranges[app_data->n_ranges * 2 - 1] != GST_CLOCK_TIME_NONE)
+	    app_data->frm_last = time_frame(app_data, app_data->ranges[app_data->n_ranges * 2 - 1]);
+    }
+    else if (app_data->key_seek == TRUE && app_data->seg_no == 0 && app_data->interval_type >= 2)
+    {
+	mpx = (app_data->interval_type == 3) ? 60 : 1;
+	app_data->frm_first = time_frame(app_data, app_data->time_start * mpx * GST_SECOND);
+
+	if (app_data->time_duration > 0)
+	    app_data->frm_last = time_frame(app_data, (app_data->time_start + app_data->time_duration) * mpx * GST_SECOND);
+    }
+
+    if (app_data->out_width > 0)
+    {
+	GstCaps *caps;
+
+	gst_util_set_object_arg (G_OBJECT (app_data->gst_objs.v_scale), "method", "4-tap");
+	caps = gst_caps_new_simple ("video/x-raw", 
+				    "width", G_TYPE_INT, app_data->out_width, 
+				    "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, 
+				    NULL);
+	g_object_set (app_data->gst_objs.v_filter, "caps", caps, NULL);
+	gst_caps_unref (caps);
+    }
+
+    /* Build the pipeline - add all the elements */
+    gst_bin_add_many (GST_BIN (app_data->c_pipeline), 
+    				app_data->gst_objs.file_src, 
+    				app_data->gst_objs.v_decode, 
+    				app_data->gst_objs.v_convert, 
+    				NULL);
+
+    if (app_data->out_width > 0)
+	gst_bin_add_many (GST_BIN (app_data->c_pipeline), app_data->gst_objs.v_scale, app_data->gst_objs.v_filter, NULL);
+
+    if (app_data->gst_objs.v_parse)
+	gst_bin_add (GST_BIN (app_data->c_pipeline), app_data->gst_objs.v_parse); 
+
+    if (app_data->gst_objs.a_sink)
+    {
+	gst_bin_add (GST_BIN (app_data->c_pipeline), app_data->gst_objs.v_caps); 
+	gst_bin_add (GST_BIN (app_data->c_pipeline), app_data->gst_objs.a_sink); 
+    }
+    else
+    {
+	gst_bin_add (GST_BIN (app_data->c_pipeline), app_data->gst_objs.encoder); 
+	gst_bin_add (GST_BIN (app_data->c_pipeline), app_data->gst_objs.mf_sink); 
+    }
+
+    return TRUE;
+}
+
+
+/* Build (link) all the pipeline elements */
+
+int link_pipeline(AppData *app_data)
+{
+    app_gst_objs *gst_objs;
+
+    /* Convenience pointer */
+    gst_objs = &(app_data->gst_objs);
+
+    /* Link */
+    if (gst_element_link (gst_objs->file_src, gst_objs->v_decode) != TRUE)
+    {
+	eng_msg(app_data, "MSG9010", NULL);
+	return FALSE;
+    }
+
+    if (gst_objs->encoder)
+    {
+	if (gst_element_link (gst_objs->v_convert, gst_objs->encoder) != TRUE)
+	{
+	    eng_msg(app_data, "MSG9010", NULL);
+	    return FALSE;
+	}
+
+	// With a possible passthrough, the sink is linked once the video type is known
+	if (gst_objs->v_parse == NULL)
+	{
+	    if (gst_element_link (gst_objs->encoder, gst_objs->mf_sink) != TRUE)
+	    {
+		eng_msg(app_data, "MSG9010", NULL);
+		return FALSE;
+	    }
+	}
+    }
+    else if (gst_objs->a_sink)
+    {
+	if (gst_element_link (gst_objs->v_convert, gst_objs->v_caps) != TRUE)
+	{
+	    eng_msg(app_data, "MSG9010", NULL);
+	    return FALSE;
+	}
+
+	if (gst_objs->v_parse == NULL)
+	{
+	    if (gst_element_link (gst_objs->v_caps, gst_objs->a_sink) != TRUE)
+	    {
+		eng_msg(app_data, "MSG9010", NULL);
+		return FALSE;
+	    }
+	}
+    }
+
+    if (gst_objs->v_scale)
+    {
+	if (gst_element_link_many (gst_objs->v_scale, gst_objs->v_filter, gst_objs->v_convert, NULL) != TRUE)
+	{
+	    eng_msg(app_data, "MSG9010", NULL);
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
+
+/* Pipeline watch and start */
+
+int start_pipeline(AppData *app_data, int init)
+{
+    GstBus *bus;
+    char s[100];
+
+    app_data->img_file_count = 0;
+    app_data->thread_init = FALSE;
+    app_data->seek_play = FALSE;
+    app_data->seek_sent = FALSE;
+    app_data->frm_count = 0;
+    app_data->next_frm = app_data->frm_first;
+    app_data->last_key = G_MAXUINT64;
+    app_data->gop_est = 0;
+    app_data->seek_req = FALSE;
+
+    sprintf(s, "Processed 0 of %u files (approx.)\n", app_data->no_of_frames);
+    eng_status(app_data, s);
+
+    if (init == TRUE)
+    {
+	/* Set up sync handler for setting the xid once the pipeline is started */
+	bus = gst_pipeline_get_bus (GST_PIPELINE (app_data->c_pipeline));
+	gst_bus_set_sync_handler (bus, (GstBusSyncHandler) bus_sync_handler, NULL, NULL);
+    }
+
+    if (set_pipeline_state(app_data, app_data->init_state) == FALSE)
+        return FALSE;
+
+    if (init == TRUE)
+    {
+	/* Add a bus watch for messages */
+	gst_bus_add_watch (bus, (GstBusFunc) bus_message_watch, app_data);
+	gst_object_unref (bus);
+    }
+
+    /* Information status line */
+    sprintf(s, "Converting video to %s images ...", app_data->image_type);
+    eng_status(app_data, s);
+
+    return TRUE;
+}
+
+
+/* Set pileline state */
+
+int set_pipeline_state(AppData *app_data, GstState state)
+{
+    GstStateChangeReturn ret, ret2;
+    char s[10];
+    GstState chg_state;
+
+    if (! GST_IS_ELEMENT(app_data->c_pipeline))
+    	return -1;
+
+    ret = gst_element_set_state (app_data->c_pipeline, state);
+
+    switch(ret)
+    {
+	case GST_STATE_CHANGE_SUCCESS:
+	case GST_STATE_CHANGE_NO_PREROLL:
+	    ret2 = gst_element_get_state (app_data->c_pipeline, &chg_state, NULL, GST_CLOCK_TIME_NONE);
+
+	    if (chg_state != state)
+	    {
+		eng_msg(app_data, "MSG9011", "Playing");
+		return FALSE;
+	    }
+
+	    break;
+
+	case GST_STATE_CHANGE_ASYNC:
+	    break;
+
+	case GST_STATE_CHANGE_FAILURE:
+	    switch (state)
+	    {
+		case GST_STATE_NULL:
+		    strcpy(s, "NULL");
+		    break;
+
+		case GST_STATE_READY:
+		    strcpy(s, "READY");
+		    break;
+
+		case GST_STATE_PAUSED:
+		    strcpy(s, "PAUSED");
+		    break;
+
+		case GST_STATE_PLAYING:
+		    strcpy(s, "PLAYING");
+		    break;
+
+		default:
+		    strcpy(s, "Unknown");
+	    }
+
+	    eng_msg(app_data, "MSG9011", s);
+	    return FALSE;
+
+	default:
+	    eng_msg(app_data, "MSG9011", "Unknown");
+	    return FALSE;
+    }
+
+    app_data->state = state;
+
+    return TRUE;
+}
+
+
+/* Shut down the pipeline and tell the front end */
+
+void end_conversion(AppData *app_data, int ok)
+{
+    GstBus *bus;
+
+    app_data->thread_init = FALSE;
+
+    if (app_data->c_pipeline != NULL)
+    {
+	/* May be ended from outside the bus watch, so make sure nothing else arrives */
+	bus = gst_pipeline_get_bus (GST_PIPELINE (app_data->c_pipeline));
+	gst_bus_remove_watch (bus);
+	gst_object_unref (bus);
+
+	// The streaming thread may be waiting on the frame pool, so let it go before stopping
+	if (ok == FALSE)
+	    pool_abort(app_data);
+
+	set_pipeline_state(app_data, GST_STATE_NULL);
+	gst_object_unref (app_data->c_pipeline);
+	app_data->c_pipeline = NULL;
+    }
+
+    /* Let the encoder threads finish the last frames */
+    if (pool_stop(app_data, ok) == FALSE)
+    	ok = FALSE;
+
+    free(app_data->filenm_tmpl);
+    app_data->filenm_tmpl = NULL;
+
+    if (app_data->cb.finished != NULL)
+	(*app_data->cb.finished)(ok, app_data->cb.data);
+
+    return;
+}
+
+
+/* Check the ref count of the element and set up if required */
+
+int create_element(GstElement **element, const char *factory_nm, const char *nm, AppData *app_data)
+{
+    int rc;
+
+    if (GST_IS_ELEMENT(*element) == TRUE)
+    {
+	if ((rc = GST_OBJECT_REFCOUNT_VALUE (*element)) > 0)
+	{
+	    //printf("%s Element %s (%s) has a ref count of %d\n", debug_hdr, nm, factory_nm, rc);   // debug
+	    return TRUE;
+	}
+    }
+
+    *element = gst_element_factory_make ((const gchar *) factory_nm, (const gchar *) nm);
+
+    if (! *element)
+    {
+	fprintf(stderr, "%s element\n", debug_hdr);
+	eng_msg(app_data, "MSG0009", (char *) factory_nm);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* Bus watch for the video window handle */
+
+GstBusSyncReply bus_sync_handler (GstBus * bus, GstMessage * message, gpointer user_data)
+{
+    // Ignore anything but 'prepare-window-handle' element messages
+    if (!gst_is_video_overlay_prepare_window_handle_message (message))
+        return GST_BUS_PASS;
+
+    if (video_window_handle != 0)
+    {
+        //g_print("%s sync reply\n", debug_hdr);
+        GstVideoOverlay *overlay;
+
+        // GST_MESSAGE_SRC (message) will be the video sink element
+        overlay = GST_VIDEO_OVERLAY (GST_MESSAGE_SRC (message));
+        gst_video_overlay_set_window_handle (overlay, video_window_handle);
+    }
+    else
+    {
+        g_warning ("Should have obtained video_window_handle by now!");
+    }
+
+    gst_message_unref (message);
+
+    return GST_BUS_DROP;
+}
+
+
+/* Bus message watch */
+
+gboolean bus_message_watch (GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+    AppData *app_data;
+    GError *err = NULL;
+    gchar *msg_str = NULL;
+
+    /* Get data */
+    app_data = (AppData *) user_data;
+
+    /* Mainly interested in EOS, but need to be playing first */
+    switch GST_MESSAGE_TYPE (msg)
+    {
+	case GST_MESSAGE_ERROR:
+	    gst_message_parse_error (msg, &err, &msg_str);
+	    sprintf(app_msg_extra, "Error received from element %s: %s\n", 
+	    			   GST_OBJECT_NAME (msg->src), msg_str);
+	    eng_msg(app_data, "MSG9012", "Error");
+
+	    g_error_free (err);
+	    g_free (msg_str);
+
+	    /* The pipeline will not go any further */
+	    end_conversion(app_data, FALSE);
+	    return FALSE;
+
+	case GST_MESSAGE_WARNING:
+	    gst_message_parse_warning (msg, &err, &msg_str);
+	    sprintf(app_msg_extra, "Warning received from element %s: %s\n", 
+	    			   GST_OBJECT_NAME (msg->src), msg_str);
+	    eng_msg(app_data, "MSG9012", "Warning");
+
+	    g_error_free (err);
+	    g_free (msg_str);
+	    break;
+
+	case GST_MESSAGE_ELEMENT:
+	    if (GST_MESSAGE_SRC (msg) == GST_OBJECT (app_data->gst_objs.mf_sink))
+	    {
+	    	app_data->img_file_count++;
+	    }
+
+	    break;
+
+	case GST_MESSAGE_STATE_CHANGED:
+	case GST_MESSAGE_ASYNC_DONE:
+	    /* Only concerned with pipeline messages at present */
+	    if (GST_MESSAGE_SRC (msg) != GST_OBJECT (app_data->c_pipeline))
+	    	break;
+
+	    GstState curr_state, pend_state;
+	    GstStateChangeReturn ret;
+	    ret = gst_element_get_state (app_data->c_pipeline, &curr_state, &pend_state, GST_CLOCK_TIME_NONE);
+
+	    /* If seek has completed for time interval conversion, start playing */
+	    if (app_data->seek_play == TRUE)
+	    {
+		app_data->seek_play = FALSE;
+		if (set_pipeline_state(app_data, GST_STATE_PLAYING) == FALSE)
+		    return FALSE;
+
+		break;
+	    }
+
+	    /* If converting a time interval, a segment or keyframes, we'll need to do a seek first (once only) */
+	    if (curr_state == GST_STATE_PAUSED && app_data->seek_sent == FALSE)
+	    	if (app_data->interval_type >= 2 || app_data->seg_no > 0)
+	    	{
+		    app_data->seek_sent = TRUE;
+
+		    // Nothing else would move the pipeline on from PAUSED
+		    if (send_seek_event(app_data) == FALSE)
+		    {
+			eng_msg(app_data, "MSG9012", "Seek failure");
+			end_conversion(app_data, FALSE);
+			return FALSE;
+		    }
+
+		    break;
+		}
+
+	    /* If not already started, let the front end know (eg. to monitor progress) */
+	    if (app_data->thread_init == FALSE)
+	    {
+		if (ret == GST_STATE_CHANGE_SUCCESS && curr_state == GST_STATE_PLAYING)
+		{
+		    app_data->thread_init = TRUE;
+
+		    if (app_data->cb.started != NULL)
+			(*app_data->cb.started)(app_data->cb.data);
+		}
+	    }
+
+	    break;
+
+
+	case GST_MESSAGE_SEGMENT_DONE:
+	    /* On to the next time range without stopping the pipeline (the last one ends in EOS) */
+	    if (app_data->n_ranges == 0 || app_data->range_no >= app_data->n_ranges - 1)
+	    	break;
+
+	    app_data->range_no++;
+
+	    if (seek_range(app_data) == FALSE)
+	    {
+		sprintf(app_msg_extra, "Time range %d could not be reached\n", app_data->range_no + 1);
+		eng_msg(app_data, "MSG9012", "Seek failure");
+		end_conversion(app_data, FALSE);
+		return FALSE;
+	    }
+
+	    break;
+
+	case GST_MESSAGE_EOS:
+	    end_conversion(app_data, TRUE);
+	    return FALSE;
+
+	default:
+	    /*
+	    printf("%s Unknown message name %s type %d\n", debug_hdr, 
+	    						   GST_MESSAGE_SRC_NAME(msg), 
+	    						   GST_MESSAGE_TYPE(msg));
+	    fflush(stdout);
+	    */
+	    break;
+    }
+
+    return TRUE;
+}
+
+
+/* Send a seek event for converting a section on video */
+
+int send_seek_event(AppData *app_data)
+{
+    gint64 start_pos, stop_pos;
+    GstClockTime stop;
+
+    /* Time ranges - this seek flushes, each range after is chained on from the end of the one before */
+    if (app_data->n_ranges > 0)
+    {
+	app_data->range_no = 0;
+
+	if (seek_range(app_data) == FALSE)
+	    return FALSE;
+
+	app_data->seek_play = TRUE;
+
+	return TRUE;
+    }
+
+    /* A segment starts exactly on a frame so that numbering carries on from the segment before */
+    /* (a time period too, if the keyframes are known) */
+    if (app_data->seg_no > 0 || app_data->key_seek == TRUE)
+    {
+	if (app_data->seg_no > 0)
+	    stop = app_data->seg_stop;
+	else if (app_data->frm_last != G_MAXUINT64)
+	    stop = frame_time(app_data, app_data->frm_last);
+	else
+	    stop = GST_CLOCK_TIME_NONE;
+
+	if (seek_frame(app_data, app_data->frm_first, stop) == FALSE)
+	    return FALSE;
+
+	app_data->seek_play = TRUE;
+
+	return TRUE;
+    }
+
+    /* Keyframes only - the demuxer and decoder skip everything else, so only I-frames are decoded */
+    if (app_data->interval_type == 4)
+    {
+	if (! gst_element_seek(app_data->c_pipeline, 1.0, GST_FORMAT_TIME, 
+			       GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_TRICKMODE | 
+			       GST_SEEK_FLAG_TRICKMODE_KEY_UNITS | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO,
+			       GST_SEEK_TYPE_SET, 0,
+			       GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE)) 
+	    return FALSE;
+
+	app_data->seek_play = TRUE;
+
+	return TRUE;
+    }
+
+    start_pos = app_data->time_start * GST_SECOND;
+    stop_pos = (app_data->time_start + app_data->time_duration) * GST_SECOND;
+
+    if (app_data->interval_type == 3)
+    {
+    	start_pos *= 60;
+    	stop_pos *= 60;
+    }
+
+    if (app_data->time_duration > 0)
+    {
+	if (! gst_element_seek(app_data->c_pipeline, 1, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+			       GST_SEEK_TYPE_SET, start_pos,
+			       GST_SEEK_TYPE_SET, stop_pos)) 
+	    return FALSE;
+    }
+    else
+    {
+	if (! gst_element_seek_simple(app_data->c_pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, start_pos)) 
+	    return FALSE;
+    }
+
+    app_data->seek_play = TRUE;
+
+    return TRUE;
+}
+
+
+/* Seek so that a frame is the first one to arrive that is wanted. With the keyframes known the seek */
+/* lands on the keyframe before it and the decoding from there is only as much as the frame probe */
+/* needs (non-reference frames are skipped). Otherwise the demuxer has to find the keyframe. */
+
+static int seek_frame(AppData *app_data, guint64 frame, GstClockTime stop)
+{
+    GstSeekFlags flags;
+    GstClockTime start;
+    guint64 key;
+
+    if (app_data->key_seek == TRUE && findex_key(app_data, frame, &key, &start) == TRUE)
+    {
+	// Snapping back from the keyframe's own time can only land on it (or one before)
+	flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE;
+    }
+    else
+    {
+	start = frame_time(app_data, frame);
+	flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE;
+    }
+
+    return gst_element_seek(app_data->c_pipeline, 1.0, GST_FORMAT_TIME, flags,
+			    GST_SEEK_TYPE_SET, start,
+			    (stop == GST_CLOCK_TIME_NONE) ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET, stop);
+}
+
+
+/* Seek to the current time range. All but the last are segment seeks, which end with SEGMENT_DONE */
+/* instead of EOS, and all but the first are non-flushing so nothing is torn down or prerolled again. */
+/* With the keyframes known the seek starts on the one before the range, unless that is back in the */
+/* range before (its frames would be wanted again). */
+
+static int seek_range(AppData *app_data)
+{
+    GstSeekFlags flags;
+    GstClockTime start, stop, t;
+    guint64 key;
+    int r;
+
+    r = app_data->range_no;
+    start = app_data->ranges[r * 2];
+    stop = app_data->ranges[r * 2 + 1];
+    flags = (r == 0) ? GST_SEEK_FLAG_FLUSH : GST_SEEK_FLAG_NONE;
+
+    if (r < app_data->n_ranges - 1)
+	flags |= GST_SEEK_FLAG_SEGMENT;
+
+    if (app_data->key_seek == TRUE && findex_key(app_data, time_frame(app_data, start), &key, &t) == TRUE &&
+    	(r == 0 || key >= time_frame(app_data, app_data->ranges[r * 2 - 1])))
+    {
+	start = t;
+	flags |= GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE;
+    }
+    else
+    {
+	flags |= GST_SEEK_FLAG_ACCURATE;
+    }
+
+    return gst_element_seek(app_data->c_pipeline, 1.0, GST_FORMAT_TIME, flags,
+			    GST_SEEK_TYPE_SET, start,
+			    (stop == GST_CLOCK_TIME_NONE) ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET, stop);
+}
+
+
+/* Check the video file and set up its full path, returns the uri to discover (NULL if there is none) */
+
+char * video_uri(AppData *app_data, char *tmp_fn)
+{  
+    char *uri;
+
+    /* Initial */
+    app_data->discover_retry = TRUE;
+    app_data->retry_count = 0;
+    app_data->mjpeg = FALSE;
+    app_data->v_width = 0;
+
+    if (*(tmp_fn) == '\0')
+    {
+	eng_msg(app_data, "MSG0002", "Video file");
+	return NULL;
+    }
+
+    /* Check file is valid */
+    if (check_file(tmp_fn) == FALSE)
+    {
+	eng_msg(app_data, "MSG0008", "Video file");
+	return NULL;
+    }
+
+#ifdef __linux__
+    /* Need to get full path */
+    char *rp;
+
+    rp = realpath(tmp_fn, NULL);
+
+    if (rp == NULL)
+    {
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", tmp_fn, errno, strerror(errno));
+	eng_msg(app_data, "MSG0006", "Failed to get full path");
+    	return NULL;
+    }
+
+    free(app_data->video_fn);
+    app_data->video_fn = rp;
+
+    /* Make sure the file name has changed */
+    if (strcmp(app_data->video_fn_last, app_data->video_fn) == 0)
+    	return NULL;
+
+    app_data->video_fn_last = (char *) realloc(app_data->video_fn_last, strlen(app_data->video_fn) + 1);
+    strcpy(app_data->video_fn_last, app_data->video_fn);
+
+    /* Set up the video file uri */
+    uri = (char *) malloc(strlen(app_data->video_fn) + 8);
+    sprintf(uri, "file://%s", app_data->video_fn);
+#else
+    int len, r, i;
+
+    /* Need to get full path */
+    len = GetFullPathName(tmp_fn, 0, NULL, NULL);
+
+    if (len == 0)
+    {
+	sprintf(app_msg_extra, "File: %s Error: zero length returned\n", tmp_fn);
+	eng_msg(app_data, "MSG0006", "Failed to get full path (length)");
+	return NULL;
+    }
+
+    app_data->video_fn = (char *) malloc(len + 1);
+
+    r = GetFullPathName(tmp_fn, len, app_data->video_fn, NULL);
+
+    if (r == 0)
+    {
+	sprintf(app_msg_extra, "File: %s Error: file error\n", tmp_fn);
+	eng_msg(app_data, "MSG0006", "Failed to get full path");
+	return NULL;
+    }
+
+    /* Make sure the file name has changed */
+    if (strcmp(app_data->video_fn_last, app_data->video_fn) == 0)
+    	return NULL;
+
+    app_data->video_fn_last = (char *) realloc(app_data->video_fn_last, strlen(app_data->video_fn) + 1);
+    strcpy(app_data->video_fn_last, app_data->video_fn);
+
+    /* Set up the video file uri */
+    uri = (char *) malloc(len + 8);
+    sprintf(uri, "file:///%s", app_data->video_fn);
+
+    for(i = 0; i < strlen(uri); i++)
+    {
+    	if (*(uri + i) == '\\')
+	    *(uri + i) = '/';
+    }
+#endif
+
+    free(app_data->info_txt);
+    app_data->info_txt = NULL;
+    findex_free(app_data);
+    app_data->findex_tried = FALSE;
+
+    return uri;
+}
+
+
+/* Video details from the discovery cache, TRUE if the video is known and unchanged */
+
+int video_cached(AppData *app_data)
+{  
+    if (app_data->no_dcache == TRUE || dcache_get(app_data) == FALSE)
+    	return FALSE;
+
+    video_info_text(app_data);
+
+    return TRUE;
+}
+
+
+/* Read the frame index for a conversion that starts now. It is not read by discovery as it may */
+/* take a while. The MP4 movie header is always read, the Matroska block scan (every block header */
+/* in the file) only if 'scan' is TRUE, when the conversion can use it for seeks. */
+/* Segments are given their parent's index, so only the parent reads it and only once. */
+
+void video_index(AppData *app_data, int scan)
+{  
+    // Looked for already, as far as is wanted now
+    if (app_data->seg_no > 0 || app_data->findex != NULL || app_data->findex_tried > scan)
+    	return;
+
+    app_data->findex_tried = scan + 1;
+
+    if (findex_load(app_data, scan) == TRUE)
+	app_data->no_of_frames = (guint) MIN(findex_count(app_data), (guint64) G_MAXUINT);
+
+    return;
+}
+
+
+/* Get the video details - from the cache or by discovery (waits for it) */
+
+int get_video_data(AppData *app_data, char *tmp_fn)
+{  
+    GError *err = NULL;
+    char *uri;
+
+    if ((uri = video_uri(app_data, tmp_fn)) == NULL)
+    	return FALSE;
+
+    if (video_cached(app_data) == TRUE)
+    {
+	free(uri);
+	eng_status(app_data, "Video discovery finished, ready to Convert");
+	return TRUE;
+    }
+
+    /* Instantiate the Discoverer */
+    while (app_data->discover_retry)
+    {
+    	app_data->discover_retry = FALSE;
+	app_data->discoverer = gst_discoverer_new (5 * GST_SECOND, &err);
+
+	if (!app_data->discoverer)
+	{
+	    free(uri);
+	    sprintf(app_msg_extra, "Error: %s\n", err->message);
+	    g_clear_error (&err);
+	    eng_msg(app_data, "MSG9013", NULL);
+	    eng_status(app_data, "Video error (MSG9013)");
+	    return FALSE;
+	}
+
+	/* Connect to the interesting signals */
+	g_signal_connect (app_data->discoverer, "discovered", G_CALLBACK (on_discovered_cb), app_data);
+	g_signal_connect (app_data->discoverer, "finished", G_CALLBACK (on_finished_cb), app_data);
+	g_signal_connect (app_data->discoverer, "starting", G_CALLBACK (on_start_cb), app_data);
+
+	/* Start the discoverer process (nothing to do yet) */
+	gst_discoverer_start (app_data->discoverer);
+
+	/* Add a request to process asynchronously the URI passed through the command line */
+	if (!gst_discoverer_discover_uri_async (app_data->discoverer, uri))
+	{
+	    eng_msg(app_data, "MSG9014", uri);
+	    g_object_unref (app_data->discoverer);
+	    free(uri);
+	    eng_status(app_data, "Video error (MSG9014)");
+	    return FALSE;
+	}
+
+	app_data->loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (app_data->loop);
+
+	/* Stop the discoverer process */
+	gst_discoverer_stop (app_data->discoverer);
+
+	/* Free resources */
+	g_object_unref (app_data->discoverer);
+	g_main_loop_unref (app_data->loop);
+    }
+
+    free(uri);
+
+    return TRUE;
+}
+
+
+/* Approximate number of images a conversion will produce */
+
+guint frames_to_convert(AppData *app_data)
+{
+    guint frames;
+    int add_fr = 0;
+    int to_end, mpx, i;
+    GstClockTime start, stop;
+
+    switch(app_data->interval_type)
+    {
+    	case 0:				// Convert every frame
+	    frames = app_data->no_of_frames;
+	    break;
+	case 1:				// Convert a selection of frames
+	    frames = (app_data->no_of_frames + (guint) app_data->frame_interval - 1) / (guint) app_data->frame_interval; 
+	    break;
+	case 2:				// Convert frames for time period (seconds)
+	case 3:				// Convert frames for time period (minutes)
+	    /* Time ranges are counted one by one, if the frame rate (or index) is known */
+	    if (app_data->n_ranges > 0)
+	    {
+		frames = 0;
+
+		for(i = 0; i < app_data->n_ranges && app_data->fr_num > 0 && app_data->fr_denom > 0; i++)
+		{
+		    start = app_data->ranges[i * 2];
+		    stop = MIN(app_data->ranges[i * 2 + 1], app_data->video_duration);
+
+		    if (stop > start)
+			frames += (guint) (time_frame(app_data, stop) - time_frame(app_data, start));
+		}
+
+		break;
+	    }
+
+	    mpx = (app_data->interval_type == 3) ? 60 : 1;
+	    to_end = (app_data->time_duration == 0);
+
+	    if (to_end)
+	    	calc_duration(app_data, mpx, &add_fr);
+
+	    /* Count the frames in the period where the frame rate (or index) is known */
+	    if (app_data->fr_num > 0 && app_data->fr_denom > 0)
+	    {
+		start = app_data->time_start * mpx * GST_SECOND;
+		stop = (to_end) ? app_data->video_duration : (app_data->time_start + app_data->time_duration) * mpx * GST_SECOND;
+		stop = MIN(stop, app_data->video_duration);
+		frames = (stop > start) ? (guint) (time_frame(app_data, stop) - time_frame(app_data, start)) : 0;
+	    }
+	    else
+	    {
+		frames = (app_data->fr_num * app_data->time_duration * mpx) + add_fr; 
+	    }
+	    break;
+	default:
+	    frames = 0;
+	    break;
+    }
+
+    return frames;
+}
+
+
+/* Calculate the duration */
+
+void calc_duration(AppData *app_data, int mpx, int *add_fr)
+{
+    gint64 segment_length, ns_rem;
+	     
+    *add_fr = 0;
+    segment_length = (app_data->video_duration - (app_data->time_start * mpx * GST_SECOND));
+    app_data->time_duration = segment_length / GST_SECOND;
+
+    // The modulus (below) represents a fraction of a nanosecond or fraction of a second of video.
+    // To improve the accuracy of the approximate total frames to convert we need to add this in,
+    // but we only use the most significant digit.
+    ns_rem = segment_length % GST_SECOND;
+    *add_fr = (get_msd(ns_rem) * 0.1) * app_data->fr_num;
+
+    return;
+}
+
+
+/* Time at which a frame is the first one at or after (half a frame early to allow for rounding) */
+
+GstClockTime frame_time(AppData *app_data, guint64 frame)
+{
+    GstClockTime t;
+
+    /* Variable frame rates need the frame index */
+    if (GST_CLOCK_TIME_IS_VALID (t = findex_time(app_data, frame)))
+    	return t;
+
+    if (frame == 0)
+    	return 0;
+
+    return gst_util_uint64_scale (2 * frame - 1, (guint64) app_data->fr_denom * GST_SECOND, 
+    				  2 * (guint64) app_data->fr_num);
+}
+
+
+/* First frame at or after a time */
+
+guint64 time_frame(AppData *app_data, GstClockTime t)
+{
+    guint64 frame;
+
+    if (findex_frame(app_data, t, FALSE, &frame) == TRUE)
+    	return frame;
+
+    return gst_util_uint64_scale_ceil (t, app_data->fr_num, (guint64) app_data->fr_denom * GST_SECOND);
+}
+
+
+/* Sampler - keep the first frame at or after each target and decide how to reach the next target. */
+/* The keyframe before the next target is in the frame index, or can be estimated from the last one */
+/* seen assuming a fixed GOP. A seek costs the overhead plus decoding from that keyframe, against */
+/* decoding straight through. */
+
+static GstPadProbeReturn sample_frame (AppData *app_data, GstBuffer *buf, guint64 frame)
+{
+    guint64 target, key_before;
+    GstClockTime t;
+
+    /* Keep track of the keyframe spacing */
+    if (! GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+    {
+	if (app_data->last_key != G_MAXUINT64 && frame > app_data->last_key)
+	    app_data->gop_est = frame - app_data->last_key;
+
+	app_data->last_key = frame;
+    }
+
+    /* Waiting for a seek to land, or not there yet */
+    if (app_data->seek_req == TRUE || frame < app_data->next_frm)
+	return GST_PAD_PROBE_DROP;
+
+    /* Keep this one - the next target is on the interval grid */
+    target = app_data->frm_first + 
+	     ((frame - app_data->frm_first) / app_data->frame_interval + 1) * app_data->frame_interval;
+    app_data->next_frm = target;
+
+    if (target >= app_data->frm_last)
+	return GST_PAD_PROBE_OK;
+
+    if (app_data->key_seek == FALSE || findex_key(app_data, target, &key_before, &t) == FALSE)
+    {
+	if (app_data->gop_est == 0 || app_data->last_key == G_MAXUINT64)
+	    return GST_PAD_PROBE_OK;
+
+	key_before = target - ((target - app_data->last_key) % app_data->gop_est);
+    }
+
+    if (key_before > frame && SAMPLE_SEEK_COST + (target - key_before) < target - frame)
+    {
+	/* Can't seek from the streaming thread, so drop frames until the main loop does it */
+	app_data->seek_req = TRUE;
+	app_data->last_key = key_before;
+	g_idle_add (sample_seek, app_data);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+
+/* Is a frame in one of the time ranges? If not, the next frame wanted is the start of the next range. */
+
+static int range_frame(AppData *app_data, guint64 frame)
+{
+    guint64 first;
+    int i;
+
+    for(i = 0; i < app_data->n_ranges; i++)
+    {
+	first = time_frame(app_data, app_data->ranges[i * 2]);
+
+	if (frame < first)
+	{
+	    app_data->next_frm = first;
+	    return FALSE;
+	}
+
+	if (app_data->ranges[i * 2 + 1] == GST_CLOCK_TIME_NONE || frame < time_frame(app_data, app_data->ranges[i * 2 + 1]))
+	    return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/* Decoder does not reconstruct non-reference frames while the next target is well ahead. */
+/* Nothing refers to them, so frames decoded later are not affected (switched per frame). */
+
+static void decode_policy (AppData *app_data, guint64 frame)
+{
+    int far;
+
+    if (app_data->gst_objs.v_dec == NULL || app_data->interval_type == 4)
+    	return;
+
+    far = (app_data->next_frm > frame + SKIP_MARGIN) ? TRUE : FALSE;
+
+    if (far == app_data->skip_on)
+    	return;
+
+    app_data->skip_on = far;
+    gst_util_set_object_arg (G_OBJECT (app_data->gst_objs.v_dec), "skip-frame", (far == TRUE) ? "1" : "0");
+
+    return;
+}
+
+
+/* Seek to the next sample target (idle callback) */
+
+static gboolean sample_seek (gpointer user_data)
+{
+    AppData *app_data;
+    GstClockTime stop;
+
+    app_data = (AppData *) user_data;
+
+    if (app_data->c_pipeline == NULL)
+    	return FALSE;
+
+    stop = (app_data->seg_no > 0) ? app_data->seg_stop : GST_CLOCK_TIME_NONE;
+
+    if (seek_frame(app_data, app_data->next_frm, stop) == FALSE)
+    {
+	/* Just decode through instead */
+	app_data->seek_req = FALSE;
+    }
+
+    return FALSE;
+}
+
+
+/* Nearest frame number for a stream time */
+
+guint64 stream_frame(AppData *app_data, GstClockTime t)
+{
+    guint64 frame;
+
+    if (findex_frame(app_data, t, TRUE, &frame) == TRUE)
+    	return frame;
+
+    return gst_util_uint64_scale_round (t, app_data->fr_num, (guint64) app_data->fr_denom * GST_SECOND);
+}
+
+
+/* Recursive division to get  */
+
+int get_msd(gint64 num)
+{
+    gint64 n;
+    n = num / 10;
+
+    if (n > 0)
+    	return get_msd(n);
+    else
+    	return num;
+}
+
+
+/* Pass a message to the front end or just log it */
+
+void eng_msg(AppData *app_data, char *msg_id, char *opt_str)
+{
+    if (app_data->cb.msg != NULL)
+	(*app_data->cb.msg)(msg_id, opt_str, app_data->cb.data);
+    else
+	log_msg(msg_id, opt_str);
+
+    return;
+}
+
+
+/* Pass a status line to the front end */
+
+void eng_status(AppData *app_data, char *s)
+{
+    if (app_data->cb.status != NULL)
+	(*app_data->cb.status)(s, app_data->cb.data);
+
+    return;
+}
+
+
+/***** CALLBACKS *****/
+
+
+/* Callback for decoder - dynamic linking to next element in pipeline */
+
+static void cb_newpad (GstElement *decodebin, GstPad *pad, gpointer user_data)
+{
+    GstPad *link_pad;			// Either the videoconvert, videoscale or jpegparse pad
+    AppData *app_data;
+    GstPadLinkReturn r;
+    GstCaps *caps;
+    const gchar *nm;
+    GstElement *last, *sink;
+    GstStructure *st;
+    gint n, d;
+    int jpeg;
+
+    /* Initial */
+    app_data = (AppData *) user_data;
+
+    /* Only interested in video (raw or jpeg for passthrough) */
+    if ((caps = gst_pad_get_current_caps (pad)) == NULL)
+    	caps = gst_pad_query_caps (pad, NULL);
+
+    st = gst_caps_get_structure (caps, 0);
+    nm = gst_structure_get_name (st);
+    jpeg = (strcmp(nm, "image/jpeg") == 0) ? TRUE : FALSE;
+
+    if (jpeg == FALSE && strncmp(nm, "video/", 6) != 0)
+    {
+	gst_caps_unref (caps);
+	return;
+    }
+
+    // A still image (no frame rate) is not the video when discovery found one with a frame rate
+    if (app_data->fr_num > 0 && gst_structure_get_fraction (st, "framerate", &n, &d) && n == 0)
+    {
+	gst_caps_unref (caps);
+	return;
+    }
+
+    gst_caps_unref (caps);
+
+    /* Only link once - the first video stream decides the branch, any other (eg. cover art) is left */
+    if (branch_linked(app_data) == TRUE)
+    	return;
+
+    app_data->passthru = jpeg;
+
+    if (app_data->passthru == TRUE)
+	link_pad = gst_element_get_static_pad (app_data->gst_objs.v_parse, "sink");
+    else if (app_data->gst_objs.v_scale)
+	link_pad = gst_element_get_static_pad (app_data->gst_objs.v_scale, "sink");
+    else
+	link_pad = gst_element_get_static_pad (app_data->gst_objs.v_convert, "sink");
+
+    /* Finish the chosen branch to the sink if not done yet */
+    if (app_data->gst_objs.v_parse)
+    {
+	if (app_data->gst_objs.a_sink)
+	{
+	    last = (app_data->passthru == TRUE) ? app_data->gst_objs.v_parse : app_data->gst_objs.v_caps;
+	    sink = app_data->gst_objs.a_sink;
+	}
+	else
+	{
+	    last = (app_data->passthru == TRUE) ? app_data->gst_objs.v_parse : app_data->gst_objs.encoder;
+	    sink = app_data->gst_objs.mf_sink;
+	}
+
+	if (gst_element_link (last, sink) != TRUE)
+	{
+	    g_object_unref (link_pad);
+	    return;
+	}
+    }
+
+    /* Link and continue pipeline */
+    r = gst_pad_link (pad, link_pad);
+
+    g_object_unref (link_pad);
+
+    /* A segment must only pass its own frames and only every nth frame may be wanted. */
+    /* A keyframe seek lands before the first frame wanted, so those frames must go too, */
+    /* as must any outside the time ranges. */
+    if (r == GST_PAD_LINK_OK && (app_data->seg_no > 0 || app_data->frame_interval > 1 || app_data->key_seek == TRUE ||
+				 app_data->n_ranges > 0))
+    {
+	gst_segment_init (&(app_data->probe_seg), GST_FORMAT_TIME);
+	gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, 
+			   frame_probe, app_data, NULL);
+    }
+}
+
+
+/* Either branch already has the video */
+
+static int branch_linked(AppData *app_data)
+{
+    GstElement *el[2];
+    GstPad *sink_pad;
+    int i, linked;
+
+    el[0] = app_data->gst_objs.v_parse;
+    el[1] = (app_data->gst_objs.v_scale) ? app_data->gst_objs.v_scale : app_data->gst_objs.v_convert;
+    linked = FALSE;
+
+    for(i = 0; i < 2 && linked == FALSE; i++)
+    {
+	if (el[i] == NULL)
+	    continue;
+
+	sink_pad = gst_element_get_static_pad (el[i], "sink");
+	linked = GST_PAD_IS_LINKED (sink_pad);
+	g_object_unref (sink_pad);
+    }
+
+    return linked;
+}
+
+
+/* Note the video decoder if it can skip frames (eg. libav) */
+
+static void cb_element_added (GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data)
+{
+    AppData *app_data;
+    GstElementFactory *factory;
+    const gchar *klass;
+    int lowres;
+    char s[4];
+
+    app_data = (AppData *) user_data;
+
+    if ((factory = gst_element_get_factory (element)) == NULL)
+    	return;
+
+    klass = gst_element_factory_get_metadata (factory, GST_ELEMENT_METADATA_KLASS);
+
+    if (klass == NULL || strstr(klass, "Decoder") == NULL || strstr(klass, "Video") == NULL)
+    	return;
+
+    /* Decode at a half or a quarter of the size if that is still big enough for the output */
+    if (app_data->out_width > 0 && app_data->v_width > 0 &&
+	g_object_class_find_property (G_OBJECT_GET_CLASS (element), "lowres") != NULL)
+    {
+	for(lowres = 0; lowres < 2 && (app_data->v_width >> (lowres + 1)) >= app_data->out_width; lowres++);
+
+	if (lowres > 0)
+	{
+	    sprintf(s, "%d", lowres);
+	    gst_util_set_object_arg (G_OBJECT (element), "lowres", s);
+	}
+    }
+
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (element), "skip-frame") == NULL)
+    	return;
+
+    app_data->gst_objs.v_dec = element;
+    app_data->skip_on = FALSE;
+
+    /* Keyframes only never needs anything else */
+    if (app_data->interval_type == 4)
+	gst_util_set_object_arg (G_OBJECT (element), "skip-frame", "1");
+
+    return;
+}
+
+
+/* Stop decodebin at JPEG video (eg. MJPEG) so the frames can be written as they are. */
+/* A still JPEG (cover art, thumbnail) has no frame rate and is decoded as usual. */
+
+static gboolean cb_autoplug_continue (GstElement *decodebin, GstPad *pad, GstCaps *caps, gpointer user_data)
+{
+    GstStructure *st;
+    gint n, d;
+
+    st = gst_caps_get_structure (caps, 0);
+
+    if (! gst_structure_has_name (st, "image/jpeg"))
+    	return TRUE;
+
+    if (! gst_structure_get_fraction (st, "framerate", &n, &d) || n == 0)
+    	return TRUE;
+
+    return FALSE;
+}
+
+
+/* Pad probe for decoded video - drop any frames not wanted (runs in the streaming thread) */
+
+static GstPadProbeReturn frame_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    AppData *app_data;
+    GstEvent *event;
+    GstBuffer *buf;
+    GstClockTime st;
+    GstPadProbeReturn ret;
+    guint64 frame;
+
+    app_data = (AppData *) user_data;
+
+    /* Keep the latest segment so buffer times can be turned into stream time */
+    if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+    {
+	event = GST_PAD_PROBE_INFO_EVENT (info);
+
+	if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+	{
+	    gst_event_copy_segment (event, &(app_data->probe_seg));
+
+	    /* A sample seek has landed */
+	    app_data->seek_req = FALSE;
+	}
+
+	return GST_PAD_PROBE_OK;
+    }
+
+    buf = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    /* A whole video just counts frames, a segment, the sampler, a keyframe seek or time ranges */
+    /* (with the frame rate known) need the true frame number */
+    if (app_data->seg_no == 0 && app_data->sampler == FALSE && app_data->key_seek == FALSE &&
+	(app_data->n_ranges == 0 || app_data->fr_num == 0 || app_data->fr_denom == 0))
+    {
+	frame = app_data->frm_count++;
+    }
+    else
+    {
+	if (! GST_CLOCK_TIME_IS_VALID (GST_BUFFER_PTS (buf)))
+	    return GST_PAD_PROBE_OK;
+
+	st = gst_segment_to_stream_time (&(app_data->probe_seg), GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+
+	if (! GST_CLOCK_TIME_IS_VALID (st))
+	    return GST_PAD_PROBE_OK;
+
+	frame = stream_frame(app_data, st);
+    }
+
+    if (frame < app_data->frm_first || frame >= app_data->frm_last)
+    {
+	// Decoding up from the keyframe before the first frame
+	if (frame < app_data->frm_first && app_data->key_seek == TRUE)
+	    decode_policy(app_data, frame);
+
+	return GST_PAD_PROBE_DROP;
+    }
+
+    // Between time ranges, decoding up from the keyframe before the next one
+    if (app_data->n_ranges > 0 && (app_data->key_seek == TRUE || (app_data->fr_num > 0 && app_data->fr_denom > 0)) &&
+	range_frame(app_data, frame) == FALSE)
+    {
+	if (app_data->key_seek == TRUE)
+	    decode_policy(app_data, frame);
+
+	return GST_PAD_PROBE_DROP;
+    }
+
+    if (app_data->sampler == TRUE)
+    {
+	ret = sample_frame(app_data, buf, frame);
+	decode_policy(app_data, frame);
+	return ret;
+    }
+
+    if (app_data->frame_interval > 1 && ((frame - app_data->frm_first) % app_data->frame_interval) != 0)
+	return GST_PAD_PROBE_DROP;
+
+    return GST_PAD_PROBE_OK;
+}
+
+
+/* Callback for Discoverer - Called every time the discoverer has information regarding the video selected */
+
+static void on_discovered_cb (GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, gpointer data)
+{
+    video_info_set((AppData *) data, info, err);
+}
+
+
+/* Save the details of a discovered video, TRUE if it can be converted */
+
+int video_info_set(AppData *app_data, GstDiscovererInfo *info, GError *err)
+{
+    GstDiscovererResult result;
+    const gchar *uri;
+    const GstDiscovererVideoInfo *vinfo;
+    GList *v_info_gl;
+    GstCaps *caps;
+    GList *a_info_gl;
+    int len, n_video, n_audio;
+    char *s;
+    char codec[64];
+
+    uri = gst_discoverer_info_get_uri (info);
+    result = gst_discoverer_info_get_result (info);
+
+    switch (result)
+    {
+	case GST_DISCOVERER_URI_INVALID:
+	{
+	    sprintf(app_msg_extra, "URI: %s\n", uri);
+	    log_msg("MSG9015", "Invalid URI");
+	    sprintf(app_msg_extra, "Invalid video file: %s\n", uri);
+	    break;
+	}
+	case GST_DISCOVERER_ERROR:
+	{
+	    sprintf(app_msg_extra, "Err: %s\n", err->message);
+	    log_msg("MSG9015", "Discoverer error");
+	    sprintf(app_msg_extra, "%s\n", err->message);
+	    break;
+	}
+	case GST_DISCOVERER_TIMEOUT:
+	{
+	    log_msg("MSG9015", "Timeout");
+
+	    if (app_data->retry_count < MAX_RETRY)
+	    {
+		sprintf(app_msg_extra, "Timed out while opening video file, retrying...\n");
+		app_data->retry_count++;
+		app_data->discover_retry = TRUE;
+	    }
+	    else
+	    {
+		sprintf(app_msg_extra, "Timed out while opening video file, retry later\n");
+	    }
+
+	    break;
+	}
+	case GST_DISCOVERER_BUSY:
+	{
+	    log_msg("MSG9015", "Busy");
+	    sprintf(app_msg_extra, "Video file is busy\n");
+	    break;
+	}
+	case GST_DISCOVERER_MISSING_PLUGINS:
+	{
+	    const GstStructure *gs;
+	    gchar *str;
+
+	    gs = gst_discoverer_info_get_misc (info);
+	    str = gst_structure_to_string (gs);
+
+	    sprintf(app_msg_extra, "Plugins: %s\n", str);
+	    log_msg("MSG9015", "Missing plugins");
+	    sprintf(app_msg_extra, "Video information is missing: %s\n", str);
+	    g_free (str);
+	    break;
+	}
+
+	case GST_DISCOVERER_OK:
+	    break;
+    }
+
+    if (result != GST_DISCOVERER_OK)
+    {
+	s = app_msg_text("MSG9016", app_data->video_fn);
+	len = strlen(s) + strlen(app_msg_extra) + 2;
+	s = realloc(s, len);
+	strcat(s, app_msg_extra);
+	free(app_data->info_txt);
+	app_data->info_txt = s;
+	app_msg_extra[0] = '\0';
+	return FALSE;
+    }
+
+    /* Save relevant details - duration, seekable, frame rate */
+    app_data->seekable = gst_discoverer_info_get_seekable (info);
+    codec[0] = '\0';
+
+    v_info_gl = gst_discoverer_info_get_video_streams (info);
+    n_video = g_list_length(v_info_gl);
+
+    if (v_info_gl)
+	if (g_list_length(v_info_gl) == 1)
+	{
+	    vinfo = (GstDiscovererVideoInfo *) v_info_gl->data;
+	    app_data->fr_num = gst_discoverer_video_info_get_framerate_num (vinfo);
+	    app_data->fr_denom = gst_discoverer_video_info_get_framerate_denom (vinfo);
+	    app_data->v_width = gst_discoverer_video_info_get_width (vinfo);
+
+	    /* Intra only JPEG video can be copied to JPG images */
+	    caps = gst_discoverer_stream_info_get_caps ((GstDiscovererStreamInfo *) vinfo);
+
+	    if (caps != NULL)
+	    {
+		app_data->mjpeg = gst_structure_has_name (gst_caps_get_structure (caps, 0), "image/jpeg");
+		g_strlcpy (codec, gst_structure_get_name (gst_caps_get_structure (caps, 0)), sizeof(codec));
+		gst_caps_unref (caps);
+	    }
+	}
+
+    gst_discoverer_stream_info_list_free (v_info_gl);
+
+    a_info_gl = gst_discoverer_info_get_audio_streams (info);
+    n_audio = g_list_length(a_info_gl);
+    gst_discoverer_stream_info_list_free (a_info_gl);
+
+    app_data->video_duration =  gst_discoverer_info_get_duration (info);
+
+    /* Keep for next time */
+    dcache_put(app_data, n_video, n_audio, codec);
+
+    video_info_text(app_data);
+
+    return TRUE;
+}
+
+
+/* Information text for a discovered video */
+
+static void video_info_text (AppData *app_data)
+{
+    int len;
+    guint no_of_frames;
+    guint64 n;
+    char *s;
+    char seek_yn[2], fps[20];
+    const char *approx;
+
+    if (app_data->seekable == TRUE)
+    	strcpy(seek_yn, "Y");
+    else
+    	strcpy(seek_yn, "N");
+
+    len = snprintf (NULL, 0, "%" GST_TIME_FORMAT "", GST_TIME_ARGS (app_data->video_duration));
+    app_data->fmt_duration =  (char *) malloc(len + 1);
+    sprintf (app_data->fmt_duration, "%" GST_TIME_FORMAT "", GST_TIME_ARGS (app_data->video_duration));
+
+    /* A sidecar index may say exactly, otherwise the frame rate gives an estimate. */
+    /* The container itself is not read here, discovery must stay quick. */
+    if ((n = findex_peek(app_data)) > 0)
+    {
+	no_of_frames = (guint) MIN(n, (guint64) G_MAXUINT);
+	approx = "Exactly";
+    }
+    else
+    {
+	no_of_frames = (app_data->fr_denom == 0) ? 0 :
+		       gst_util_uint64_scale (app_data->video_duration, app_data->fr_num, (guint64) app_data->fr_denom * GST_SECOND);
+	approx = "Approx.";
+    }
+
+    // NTSC and the like are not whole numbers
+    if (app_data->fr_denom > 1)
+	snprintf(fps, sizeof(fps), "%.3f", (double) app_data->fr_num / (double) app_data->fr_denom);
+    else
+	snprintf(fps, sizeof(fps), "%u", app_data->fr_num);
+
+    app_data->no_of_frames = no_of_frames;
+    s = (char *) malloc(len + 200);
+    sprintf(s, "Video duration: %s  (%s %u frames)\n" \
+               "Seekable: %s\n" \
+               "%s fps\n%s", app_data->fmt_duration, approx, no_of_frames, seek_yn, fps,
+               (app_data->mjpeg == TRUE) ? "MJPEG (JPG images are copied without re-encoding)\n" : "");
+    free(app_data->info_txt);
+    app_data->info_txt = s;
+    free(app_data->fmt_duration);
+    app_data->video_ok = TRUE;
+}
+
+
+/* Callback for Discoverer - Start scanning for video information */
+
+static void on_start_cb (GstDiscoverer *discoverer, gpointer data)
+{
+    AppData *app_data;
+
+    app_data = (AppData *) data;
+
+    app_data->video_ok = FALSE;
+    eng_status(app_data, "Getting Video information, please wait...");
+}
+
+
+/* Callback for Discoverer - Finished scanning for video information */
+
+static void on_finished_cb (GstDiscoverer *discoverer, gpointer data)
+{
+    AppData *app_data;
+
+    app_data = (AppData *) data;
+
+    if (app_data->video_ok == TRUE)
+	eng_status(app_data, "Video discovery finished, ready to Convert");
+    else
+	eng_status(app_data, "Video discovery failed");
+
+    g_main_loop_quit (app_data->loop);
+}
@@ -0,0 +1,1417 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Frame index. The exact number of frames in the video, and the time of each one,
+**		read from the container without decoding anything.
+**		MP4 / MOV - the sample tables of the first video track (stsz, stts, ctts) with
+**		the edit list applied, as qtdemux does.
+**		Matroska / WebM - the block headers of the video track in each cluster (the cues
+**		only list keyframes). The frames themselves are skipped over.
+**		Frame times are in stream time, sorted, so frame n is the nth frame shown.
+**		Other containers (and fragmented MP4) have no index and the frame rate is used.
+**		Keyframes are kept with their time, frame number and place in the file (sync
+**		samples in MP4, key blocks in Matroska) so a seek can start on the right one.
+**		The index may be kept in a sidecar file beside the video, or in the user cache
+**		directory if the video's directory cannot be written, and is read from there
+**		while the video is unchanged (size and modification time).
+**		The index is read when a conversion that can use it starts, discovery only takes
+**		the frame count from a sidecar header.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Keyframes and the sidecar index
+**	18-Oct-2026	Sidecar frame count for discovery without reading the index
+**	18-Oct-2026	Matroska block scan only when asked for
+**
+*/
+
+
+
+/* Defines */
+
+#define FI_MOOV_MAX (256 << 20)		// Largest MP4 movie header read
+#define FI_EBML_DEPTH 8
+#define FI_SIDE_EXT ".gusto-idx"		// Sidecar file name is the video name plus this
+#define FI_SIDE_DIR "gusto"			// Or in the user cache, named by a hash of the path
+#define FI_SIDE_MAGIC "GUSTOKX1"
+#define FI_SIDE_HDR 6				// Header words: magic size mtime frames flags keys
+#define FI_SIDE_TIMES 0x1			// Flag - the frame times follow the header
+#define FI_SETTLE 2				// Seconds a video must be unchanged before it is indexed
+
+#ifdef __linux__
+# define _FILE_OFFSET_BITS 64
+# define FI_SEEK fseeko
+# define FI_TELL ftello
+#else
+# define __USE_MINGW_ANSI_STDIO
+# define FI_SEEK fseeko64
+# define FI_TELL ftello64
+#endif
+
+#define FI_ID4(a, b, c, d) (((guint32) (a) << 24) | ((guint32) (b) << 16) | ((guint32) (c) << 8) | (guint32) (d))
+
+// Matroska element ids
+#define MKV_EBML 0x1A45DFA3
+#define MKV_SEGMENT 0x18538067
+#define MKV_INFO 0x1549A966
+#define MKV_TC_SCALE 0x2AD7B1
+#define MKV_TRACKS 0x1654AE6B
+#define MKV_TRACK_ENTRY 0xAE
+#define MKV_TRACK_NO 0xD7
+#define MKV_TRACK_TYPE 0x83
+#define MKV_CLUSTER 0x1F43B675
+#define MKV_TIMECODE 0xE7
+#define MKV_SIMPLE_BLOCK 0xA3
+#define MKV_BLOCK_GROUP 0xA0
+#define MKV_BLOCK 0xA1
+#define MKV_REF_BLOCK 0xFB
+#define MKV_UNKNOWN G_MAXUINT64
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _fi_key
+{
+    GstClockTime pts;
+    guint64 offset;			/* Where the frame (MP4) or its block (Matroska) is in the file, 0 if not known */
+    guint64 frame;			/* Frame number, in the order shown */
+} FiKey;
+
+typedef struct _frame_index
+{
+    guint64 n_frames;
+    GstClockTime *pts;			/* Time of each frame, NULL if only the number is known */
+    guint64 n_keys;
+    FiKey *keys;			/* Keyframes in frame order, NULL if not known */
+} FrameIndex;
+
+typedef struct _mp4_walk
+{
+    guchar *stsc;			/* Samples per chunk */
+    guint32 n_stsc;
+    guchar *co;				/* Chunk offsets */
+    guint32 n_co;
+    int co64;
+    guchar *sz;				/* Sample sizes, unless they are all the same */
+    int sz_bits;
+    guint32 sz_fixed;
+    guint32 n_sz;
+    guint32 e;				/* Samples per chunk entry in use */
+    guint32 c;				/* Chunk in use (from 1) */
+    guint32 left;			/* Samples left in the chunk */
+    guint64 off;			/* Offset of the next sample */
+    int ok;
+} Mp4Walk;
+
+typedef struct _mkv_scan
+{
+    FILE *fd;
+    guint64 tc_scale;			/* Nanoseconds per timecode */
+    guint64 video_track;		/* 0 until the tracks are read */
+    guint64 entry_no;			/* Track entry being read */
+    int entry_video;
+    gint64 cluster_tc;
+    GArray *pts;
+    GArray *keys;
+    guint64 laced;			/* Frames in laced blocks (no time for each) */
+    off_t grp_pos;			/* Block group being read */
+    int grp_block;			/* It has a video block (grp_key) */
+    int grp_ref;			/* It refers to other frames, so is not a keyframe */
+    FiKey grp_key;
+} MkvScan;
+
+
+/* Prototypes */
+
+int findex_load(AppData *, int);
+guint64 findex_peek(AppData *);
+void findex_free(AppData *);
+guint64 findex_count(AppData *);
+GstClockTime findex_time(AppData *, guint64);
+int findex_frame(AppData *, GstClockTime, int, guint64 *);
+guint64 findex_keys(AppData *);
+int findex_key(AppData *, guint64, guint64 *, GstClockTime *);
+static gint64 fi_lower(FrameIndex *, GstClockTime);
+static gint fi_cmp(gconstpointer, gconstpointer);
+static gint fi_key_cmp(gconstpointer, gconstpointer);
+static int fi_side_read(char *, FrameIndex *);
+static void fi_side_write(char *, FrameIndex *);
+static int fi_side_key(char *, gint64 *, gint64 *, time_t *);
+static char * fi_side_fn(char *, int);
+static guint64 fi_le64(guchar *);
+static void fi_put64(FILE *, guint64);
+static int fi_mp4(FILE *, GArray *, GArray *);
+static int fi_mp4_trak(guchar *, guint64, guint32, GArray *, GArray *);
+static int fi_mp4_walk_init(Mp4Walk *, guchar *, guint64);
+static guint64 fi_mp4_walk_next(Mp4Walk *, guint64);
+static guchar * fi_box(guchar *, guint64, guint32, guint64 *);
+static guint32 fi_u32(guchar *);
+static guint64 fi_u64(guchar *);
+static int fi_mkv(FILE *, GArray *, GArray *, guint64 *);
+static int fi_mkv_level(MkvScan *, guint64, int);
+static int fi_mkv_block(MkvScan *, guint32, guint64, off_t);
+static int fi_ebml_id(FILE *, guint32 *);
+static int fi_ebml_size(FILE *, guint64 *);
+static guint64 fi_ebml_uint(FILE *, guint64);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-findex.c ";
+
+
+/* Read the frame index of the video, TRUE if there is one. A sidecar index is used if there is one */
+/* for the video as it is now, otherwise the container is read (and the sidecar written if wanted). */
+/* MP4 is one bounded read of the movie header, Matroska means reading every block header in the */
+/* file, so that is only done if 'scan' is TRUE. */
+
+int findex_load(AppData *app_data, int scan)
+{
+    FrameIndex *fi;
+    FILE *fd;
+    GArray *pts, *keys;
+    guchar magic[8];
+    guint64 untimed, i;
+    int ok;
+
+    findex_free(app_data);
+
+    fi = (FrameIndex *) malloc(sizeof(FrameIndex));
+    memset(fi, 0, sizeof(FrameIndex));
+
+    if (fi_side_read(app_data->video_fn, fi) == TRUE)
+    {
+	app_data->findex = (void *) fi;
+	return TRUE;
+    }
+
+    if ((fd = g_fopen (app_data->video_fn, "rb")) == NULL)
+    {
+	free(fi);
+    	return FALSE;
+    }
+
+    if (fread(magic, 1, sizeof(magic), fd) != sizeof(magic))
+    {
+	fclose(fd);
+	free(fi);
+    	return FALSE;
+    }
+
+    rewind(fd);
+    pts = g_array_new (FALSE, FALSE, sizeof(GstClockTime));
+    keys = g_array_new (FALSE, FALSE, sizeof(FiKey));
+    untimed = 0;
+
+    /* Containers are known by their first bytes, not the file extension */
+    if (fi_u32(magic) == MKV_EBML)
+	ok = (scan == TRUE) ? fi_mkv(fd, pts, keys, &untimed) : FALSE;
+    else if (memcmp(magic + 4, "ftyp", 4) == 0 || memcmp(magic + 4, "moov", 4) == 0 ||
+    	     memcmp(magic + 4, "mdat", 4) == 0 || memcmp(magic + 4, "wide", 4) == 0 ||
+    	     memcmp(magic + 4, "free", 4) == 0)
+	ok = fi_mp4(fd, pts, keys);
+    else
+	ok = FALSE;
+
+    fclose(fd);
+
+    /* Some frames without their own time (laced Matroska blocks) leave just the count */
+    if (ok == TRUE && untimed == 0)
+    {
+	g_array_sort (pts, fi_cmp);
+	fi->n_frames = pts->len;
+	fi->pts = (GstClockTime *) g_array_free (pts, FALSE);
+
+	// Keyframes are numbered by where their time falls among all the frames
+	g_array_sort (keys, fi_key_cmp);
+	fi->n_keys = keys->len;
+	fi->keys = (FiKey *) g_array_free (keys, FALSE);
+
+	for(i = 0; i < fi->n_keys; i++)
+	    fi->keys[i].frame = (guint64) fi_lower(fi, fi->keys[i].pts);
+
+	if (fi->n_keys == 0)
+	{
+	    g_free (fi->keys);
+	    fi->keys = NULL;
+	}
+    }
+    else
+    {
+	if (ok == TRUE)
+	    fi->n_frames = pts->len + untimed;
+
+	g_array_free (pts, TRUE);
+	g_array_free (keys, TRUE);
+    }
+
+    if (fi->n_frames == 0)
+    {
+	free(fi);
+	return FALSE;
+    }
+
+    app_data->findex = (void *) fi;
+
+    if (app_data->seek_index == TRUE)
+	fi_side_write(app_data->video_fn, fi);
+
+    return TRUE;
+}
+
+
+/* Frames in a sidecar index made for the video as it is now, 0 if there is none. Only the header */
+/* is read (and the file size checked), so discovery can give the exact count at no cost. */
+
+guint64 findex_peek(AppData *app_data)
+{
+    FILE *fd;
+    gchar *fn;
+    guchar hdr[FI_SIDE_HDR * 8];
+    gint64 size, mtime, len;
+    guint64 n_frames, n_times, n_keys;
+    time_t t;
+    int local;
+
+    if (fi_side_key(app_data->video_fn, &size, &mtime, &t) == FALSE)
+    	return 0;
+
+    n_frames = 0;
+
+    for(local = TRUE; local >= FALSE && n_frames == 0; local--)
+    {
+	if ((fn = fi_side_fn(app_data->video_fn, local)) == NULL)
+	    continue;
+
+	if ((fd = g_fopen (fn, "rb")) != NULL)
+	{
+	    if (fread(hdr, 1, sizeof(hdr), fd) == sizeof(hdr) && memcmp(hdr, FI_SIDE_MAGIC, 8) == 0 &&
+		(gint64) fi_le64(hdr + 8) == size && (gint64) fi_le64(hdr + 16) == mtime &&
+		FI_SEEK(fd, 0, SEEK_END) == 0)
+	    {
+		// The sizes must account for the whole file, as for a full read
+		n_times = (fi_le64(hdr + 32) & FI_SIDE_TIMES) ? fi_le64(hdr + 24) : 0;
+		n_keys = fi_le64(hdr + 40);
+		len = (gint64) FI_TELL(fd) / 8 - FI_SIDE_HDR;
+
+		if (len >= 0 && n_times <= (guint64) len && n_times + n_keys * 3 == (guint64) len &&
+		    n_keys <= (guint64) len / 3 && (n_keys == 0 || n_times > 0))
+		    n_frames = fi_le64(hdr + 24);
+	    }
+
+	    fclose(fd);
+	}
+
+	g_free (fn);
+    }
+
+    return n_frames;
+}
+
+
+/* Free the index - it belongs to the conversion that loaded it (segments share it) */
+
+void findex_free(AppData *app_data)
+{
+    FrameIndex *fi;
+
+    if ((fi = (FrameIndex *) app_data->findex) == NULL)
+    	return;
+
+    g_free (fi->pts);
+    g_free (fi->keys);
+    free(fi);
+    app_data->findex = NULL;
+
+    return;
+}
+
+
+/* Frames in the video, 0 if not known */
+
+guint64 findex_count(AppData *app_data)
+{
+    if (app_data->findex == NULL)
+    	return 0;
+
+    return ((FrameIndex *) app_data->findex)->n_frames;
+}
+
+
+/* Time to seek to for a frame - half way from the frame before, as for a fixed rate. */
+/* GST_CLOCK_TIME_NONE if the frame times are not known. */
+
+GstClockTime findex_time(AppData *app_data, guint64 frame)
+{
+    FrameIndex *fi;
+
+    fi = (FrameIndex *) app_data->findex;
+
+    if (fi == NULL || fi->pts == NULL)
+    	return GST_CLOCK_TIME_NONE;
+
+    if (frame == 0)
+    	return 0;
+
+    // Just after the last frame is the end
+    if (frame >= fi->n_frames)
+    	return fi->pts[fi->n_frames - 1] + 1;
+
+    return fi->pts[frame - 1] + (fi->pts[frame] - fi->pts[frame - 1] + 1) / 2;
+}
+
+
+/* Frame for a time - the first at or after it, or the nearest (round). FALSE if the frame times are not known. */
+
+int findex_frame(AppData *app_data, GstClockTime t, int round, guint64 *frame)
+{
+    FrameIndex *fi;
+    gint64 i;
+
+    fi = (FrameIndex *) app_data->findex;
+
+    if (fi == NULL || fi->pts == NULL)
+    	return FALSE;
+
+    i = fi_lower(fi, t);
+
+    if (round == TRUE)
+    {
+	if (i >= (gint64) fi->n_frames)
+	    i = fi->n_frames - 1;
+	else if (i > 0 && t - fi->pts[i - 1] < fi->pts[i] - t)
+	    i--;
+    }
+
+    *frame = (guint64) i;
+
+    return TRUE;
+}
+
+
+/* Keyframes in the video, 0 if not known */
+
+guint64 findex_keys(AppData *app_data)
+{
+    if (app_data->findex == NULL)
+    	return 0;
+
+    return ((FrameIndex *) app_data->findex)->n_keys;
+}
+
+
+/* Last keyframe at or before a frame, and its time. FALSE if there is none known. */
+
+int findex_key(AppData *app_data, guint64 frame, guint64 *key, GstClockTime *t)
+{
+    FrameIndex *fi;
+    gint64 lo, hi, mid;
+
+    fi = (FrameIndex *) app_data->findex;
+
+    if (fi == NULL || fi->keys == NULL)
+    	return FALSE;
+
+    lo = 0;
+    hi = (gint64) fi->n_keys;
+
+    while(lo < hi)
+    {
+	mid = lo + (hi - lo) / 2;
+
+	if (fi->keys[mid].frame <= frame)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    if (lo == 0)
+    	return FALSE;
+
+    *key = fi->keys[lo - 1].frame;
+    *t = fi->keys[lo - 1].pts;
+
+    return TRUE;
+}
+
+
+/* Number of frames before a time */
+
+static gint64 fi_lower(FrameIndex *fi, GstClockTime t)
+{
+    gint64 lo, hi, mid;
+
+    lo = 0;
+    hi = (gint64) fi->n_frames;
+
+    while(lo < hi)
+    {
+	mid = lo + (hi - lo) / 2;
+
+	if (fi->pts[mid] < t)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return lo;
+}
+
+
+static gint fi_cmp(gconstpointer a, gconstpointer b)
+{
+    GstClockTime t1, t2;
+
+    t1 = *(const GstClockTime *) a;
+    t2 = *(const GstClockTime *) b;
+
+    return (t1 < t2) ? -1 : (t1 > t2);
+}
+
+
+static gint fi_key_cmp(gconstpointer a, gconstpointer b)
+{
+    return fi_cmp(&(((const FiKey *) a)->pts), &(((const FiKey *) b)->pts));
+}
+
+
+/***** SIDECAR *****/
+
+
+/* Index from a sidecar file made for the video as it is now. Little endian 64 bit words - a header, */
+/* the frame times (if known) and each keyframe (time, offset, frame number). */
+
+static int fi_side_read(char *path, FrameIndex *fi)
+{
+    gchar *fn, *buf;
+    guchar *p;
+    gsize len;
+    gint64 size, mtime;
+    guint64 flags, n_times, i;
+    time_t t;
+    int local, ok;
+
+    if (fi_side_key(path, &size, &mtime, &t) == FALSE)
+    	return FALSE;
+
+    /* Beside the video first, then in the cache */
+    buf = NULL;
+
+    for(local = TRUE; local >= FALSE && buf == NULL; local--)
+    {
+	if ((fn = fi_side_fn(path, local)) == NULL)
+	    continue;
+
+	if (g_file_get_contents (fn, &buf, &len, NULL) == FALSE)
+	    buf = NULL;
+	else if (len < FI_SIDE_HDR * 8 || memcmp(buf, FI_SIDE_MAGIC, 8) != 0 ||
+		 (gint64) fi_le64((guchar *) buf + 8) != size || (gint64) fi_le64((guchar *) buf + 16) != mtime)
+	{
+	    g_free (buf);
+	    buf = NULL;
+	}
+
+	g_free (fn);
+    }
+
+    if (buf == NULL)
+    	return FALSE;
+
+    /* The sizes must account for the whole file */
+    p = (guchar *) buf;
+    fi->n_frames = fi_le64(p + 24);
+    flags = fi_le64(p + 32);
+    fi->n_keys = fi_le64(p + 40);
+    n_times = (flags & FI_SIDE_TIMES) ? fi->n_frames : 0;
+    len = len / 8 - FI_SIDE_HDR;
+
+    ok = (fi->n_frames > 0 && n_times <= len && fi->n_keys <= (len - n_times) / 3 && 
+    	  n_times + fi->n_keys * 3 == len && (fi->n_keys == 0 || n_times > 0));
+
+    if (ok == TRUE)
+    {
+	p += FI_SIDE_HDR * 8;
+
+	if (n_times > 0)
+	{
+	    fi->pts = (GstClockTime *) g_malloc (sizeof(GstClockTime) * n_times);
+
+	    for(i = 0; i < n_times; i++, p += 8)
+		fi->pts[i] = fi_le64(p);
+	}
+
+	if (fi->n_keys > 0)
+	{
+	    fi->keys = (FiKey *) g_malloc (sizeof(FiKey) * fi->n_keys);
+
+	    for(i = 0; i < fi->n_keys; i++, p += 24)
+	    {
+		fi->keys[i].pts = fi_le64(p);
+		fi->keys[i].offset = fi_le64(p + 8);
+		fi->keys[i].frame = fi_le64(p + 16);
+	    }
+	}
+    }
+    else
+    {
+	fi->n_frames = 0;
+	fi->n_keys = 0;
+    }
+
+    g_free (buf);
+
+    return ok;
+}
+
+
+/* Write the sidecar, beside the video if its directory may be written to, otherwise in the cache */
+
+static void fi_side_write(char *path, FrameIndex *fi)
+{
+    FILE *fd;
+    gchar *fn, *tmp;
+    gint64 size, mtime;
+    guint64 i;
+    time_t t;
+    int local, ok;
+
+    if (fi_side_key(path, &size, &mtime, &t) == FALSE)
+    	return;
+
+    // A video still being written would be out of date straight away
+    if (t + FI_SETTLE > time(NULL))
+    	return;
+
+    for(local = TRUE; local >= FALSE; local--)
+    {
+	if ((fn = fi_side_fn(path, local)) == NULL)
+	    continue;
+
+	tmp = g_strdup_printf ("%s.%08x", fn, g_random_int ());
+
+	if ((fd = g_fopen (tmp, "wb")) == NULL)
+	{
+	    g_free (tmp);
+	    g_free (fn);
+	    continue;
+	}
+
+	fwrite(FI_SIDE_MAGIC, 1, 8, fd);
+	fi_put64(fd, (guint64) size);
+	fi_put64(fd, (guint64) mtime);
+	fi_put64(fd, fi->n_frames);
+	fi_put64(fd, (fi->pts != NULL) ? FI_SIDE_TIMES : 0);
+	fi_put64(fd, (fi->pts != NULL) ? fi->n_keys : 0);
+
+	for(i = 0; fi->pts != NULL && i < fi->n_frames; i++)
+	    fi_put64(fd, fi->pts[i]);
+
+	for(i = 0; fi->pts != NULL && i < fi->n_keys; i++)
+	{
+	    fi_put64(fd, fi->keys[i].pts);
+	    fi_put64(fd, fi->keys[i].offset);
+	    fi_put64(fd, fi->keys[i].frame);
+	}
+
+	ok = (ferror(fd) == 0);
+	ok = (fclose(fd) == 0 && ok);
+
+	if (ok == TRUE && g_rename (tmp, fn) == 0)
+	{
+	    g_free (tmp);
+	    g_free (fn);
+	    return;
+	}
+
+	g_unlink (tmp);
+	g_free (tmp);
+	g_free (fn);
+    }
+
+    return;
+}
+
+
+/* Sidecar key for a video - size and modification time */
+
+static int fi_side_key(char *path, gint64 *size, gint64 *mtime, time_t *t)
+{
+    GStatBuf st;
+
+    if (path == NULL || g_stat (path, &st) != 0)
+    	return FALSE;
+
+    *size = (gint64) st.st_size;
+    *t = st.st_mtime;
+
+#ifdef __linux__
+    *mtime = (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + st.st_mtim.tv_nsec;
+#else
+    *mtime = (gint64) st.st_mtime * G_GINT64_CONSTANT (1000000000);
+#endif
+
+    return TRUE;
+}
+
+
+/* Sidecar file name - beside the video, or in the cache (the directory is created if need be) */
+
+static char * fi_side_fn(char *path, int local)
+{
+    gchar *dir, *fn, *hash;
+
+    if (local == TRUE)
+	return g_strconcat (path, FI_SIDE_EXT, NULL);
+
+    dir = g_build_filename (g_get_user_cache_dir (), FI_SIDE_DIR, NULL);
+
+    if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+	g_free (dir);
+	return NULL;
+    }
+
+    hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, path, -1);
+    fn = g_strconcat (dir, G_DIR_SEPARATOR_S, hash, FI_SIDE_EXT, NULL);
+    g_free (hash);
+    g_free (dir);
+
+    return fn;
+}
+
+
+static guint64 fi_le64(guchar *p)
+{
+    guint64 v;
+    int i;
+
+    v = 0;
+
+    for(i = 7; i >= 0; i--)
+	v = (v << 8) | (guint64) p[i];
+
+    return v;
+}
+
+
+static void fi_put64(FILE *fd, guint64 v)
+{
+    guchar b[8];
+    int i;
+
+    for(i = 0; i < 8; i++, v >>= 8)
+	b[i] = (guchar) (v & 0xff);
+
+    fwrite(b, 1, 8, fd);
+
+    return;
+}
+
+
+/***** MP4 *****/
+
+
+/* Find the movie header and read the first video track in it */
+
+static int fi_mp4(FILE *fd, GArray *pts, GArray *keys)
+{
+    guchar hdr[16], *moov, *p, *trak;
+    guint64 size, len;
+    guint32 mv_scale;
+    int ok;
+
+    moov = NULL;
+    size = 0;
+
+    /* Top level boxes - the movie header may be before or after the media */
+    while(fread(hdr, 1, 8, fd) == 8)
+    {
+	size = fi_u32(hdr);
+	len = 8;
+
+	if (size == 1)
+	{
+	    if (fread(hdr + 8, 1, 8, fd) != 8)
+		return FALSE;
+
+	    size = fi_u64(hdr + 8);
+	    len = 16;
+	}
+
+	// A box to the end of the file (size 0) is the media, so the movie header is not after it
+	if (size < len)
+	    return FALSE;
+
+	if (fi_u32(hdr + 4) == FI_ID4('m','o','o','v'))
+	{
+	    if (size - len > FI_MOOV_MAX)
+		return FALSE;
+
+	    size -= len;
+	    moov = (guchar *) malloc(size);
+
+	    if (fread(moov, 1, size, fd) != size)
+	    {
+		free(moov);
+		return FALSE;
+	    }
+
+	    break;
+	}
+
+	if (FI_SEEK(fd, (off_t) (size - len), SEEK_CUR) != 0)
+	    return FALSE;
+    }
+
+    if (moov == NULL)
+    	return FALSE;
+
+    /* Movie timescale, for empty edits */
+    mv_scale = 0;
+
+    if ((p = fi_box(moov, size, FI_ID4('m','v','h','d'), &len)) != NULL && len >= 24)
+	mv_scale = fi_u32(p + ((p[0] == 1) ? 20 : 12));
+
+    /* Each track until a video one */
+    ok = FALSE;
+    p = moov;
+
+    while(ok == FALSE && (trak = fi_box(p, (guint64) (moov + size - p), FI_ID4('t','r','a','k'), &len)) != NULL)
+    {
+	ok = fi_mp4_trak(trak, len, mv_scale, pts, keys);
+	p = trak + len;
+    }
+
+    free(moov);
+
+    return ok;
+}
+
+
+/* Frame times and keyframes for a track, FALSE if it is not video or has no sample tables (fragmented) */
+
+static int fi_mp4_trak(guchar *trak, guint64 trak_len, guint32 mv_scale, GArray *pts, GArray *keys)
+{
+    guchar *mdia, *minf, *stbl, *p, *stts, *ctts, *elst, *stss;
+    guint64 mdia_len, minf_len, stbl_len, len, stts_len, ctts_len, elst_len, stss_len;
+    guint32 timescale, n_stts, n_ctts, n_elst, stts_run, ctts_run, n_stss, s;
+    guint64 n, i, dts, edit_ns, edit_end, offset;
+    gint64 media_time, ticks;
+    GstClockTime t;
+    Mp4Walk walk;
+    FiKey key;
+    int j, k, v, all_key, is_key;
+
+    if ((mdia = fi_box(trak, trak_len, FI_ID4('m','d','i','a'), &mdia_len)) == NULL)
+    	return FALSE;
+
+    /* Video only */
+    if ((p = fi_box(mdia, mdia_len, FI_ID4('h','d','l','r'), &len)) == NULL || len < 12 ||
+    	fi_u32(p + 8) != FI_ID4('v','i','d','e'))
+    	return FALSE;
+
+    if ((p = fi_box(mdia, mdia_len, FI_ID4('m','d','h','d'), &len)) == NULL || len < 24)
+    	return FALSE;
+
+    timescale = fi_u32(p + ((p[0] == 1) ? 20 : 12));
+
+    if (timescale == 0)
+    	return FALSE;
+
+    if ((minf = fi_box(mdia, mdia_len, FI_ID4('m','i','n','f'), &minf_len)) == NULL ||
+	(stbl = fi_box(minf, minf_len, FI_ID4('s','t','b','l'), &stbl_len)) == NULL)
+    	return FALSE;
+
+    /* Number of frames */
+    if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','s','z'), &len)) != NULL && len >= 12)
+	n = fi_u32(p + 8);
+    else if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','z','2'), &len)) != NULL && len >= 12)
+	n = fi_u32(p + 8);
+    else
+    	return FALSE;
+
+    if (n == 0)
+    	return FALSE;
+
+    /* Decode times, with the composition offsets (B-frames) */
+    if ((stts = fi_box(stbl, stbl_len, FI_ID4('s','t','t','s'), &stts_len)) == NULL || stts_len < 8)
+    	return FALSE;
+
+    n_stts = fi_u32(stts + 4);
+
+    if (stts_len < 8 + (guint64) n_stts * 8)
+    	return FALSE;
+
+    ctts = fi_box(stbl, stbl_len, FI_ID4('c','t','t','s'), &ctts_len);
+    n_ctts = (ctts != NULL && ctts_len >= 8) ? fi_u32(ctts + 4) : 0;
+
+    if (n_ctts > 0 && ctts_len < 8 + (guint64) n_ctts * 8)
+    	n_ctts = 0;
+
+    /* First edit - an empty one delays the media, the next says where it starts and for how long */
+    media_time = 0;
+    edit_ns = 0;
+    edit_end = GST_CLOCK_TIME_NONE;
+    p = fi_box(trak, trak_len, FI_ID4('e','d','t','s'), &len);
+
+    if (p != NULL && (elst = fi_box(p, len, FI_ID4('e','l','s','t'), &elst_len)) != NULL && elst_len >= 8)
+    {
+	v = elst[0];
+	n_elst = fi_u32(elst + 4);
+	p = elst + 8;
+
+	for(i = 0; i < n_elst && (guint64) ((p - elst) + ((v == 1) ? 20 : 12)) <= elst_len; i++)
+	{
+	    len = (v == 1) ? fi_u64(p) : fi_u32(p);
+	    ticks = (v == 1) ? (gint64) fi_u64(p + 8) : (gint64) (gint32) fi_u32(p + 4);
+	    p += (v == 1) ? 20 : 12;
+
+	    if (mv_scale == 0)
+		break;
+
+	    if (ticks == -1)
+	    {
+		edit_ns += gst_util_uint64_scale (len, GST_SECOND, mv_scale);
+		continue;
+	    }
+
+	    media_time = ticks;
+
+	    if (len > 0)
+		edit_end = edit_ns + gst_util_uint64_scale (len, GST_SECOND, mv_scale);
+
+	    break;
+	}
+    }
+
+    /* Keyframes - the sync samples, or every sample if there is no table. Where each one is in the file. */
+    stss = fi_box(stbl, stbl_len, FI_ID4('s','t','s','s'), &stss_len);
+    all_key = (stss == NULL);
+    n_stss = (stss != NULL && stss_len >= 8) ? fi_u32(stss + 4) : 0;
+
+    if (n_stss > 0 && stss_len < 8 + (guint64) n_stss * 4)
+    	n_stss = 0;
+
+    fi_mp4_walk_init(&walk, stbl, stbl_len);
+
+    dts = 0;
+    j = 0;
+    k = 0;
+    s = 0;
+    stts_run = (n_stts > 0) ? fi_u32(stts + 8) : 0;
+    ctts_run = (n_ctts > 0) ? fi_u32(ctts + 8) : 0;
+
+    for(i = 0; i < n; i++)
+    {
+	while(stts_run == 0 && ++j < (int) n_stts)
+	    stts_run = fi_u32(stts + 8 + j * 8);
+
+	if (j >= (int) n_stts)
+	    break;
+
+	offset = fi_mp4_walk_next(&walk, i);
+
+	while(s < n_stss && fi_u32(stss + 8 + s * 4) < i + 1)
+	    s++;
+
+	is_key = (all_key || (s < n_stss && fi_u32(stss + 8 + s * 4) == i + 1));
+
+	ticks = (gint64) dts - media_time;
+
+	if (n_ctts > 0)
+	{
+	    while(ctts_run == 0 && ++k < (int) n_ctts)
+		ctts_run = fi_u32(ctts + 8 + k * 8);
+
+	    if (k < (int) n_ctts)
+	    {
+		ticks += (ctts[0] == 1) ? (gint64) (gint32) fi_u32(ctts + 12 + k * 8) : (gint64) fi_u32(ctts + 12 + k * 8);
+		ctts_run--;
+	    }
+	}
+
+	dts += fi_u32(stts + 12 + j * 8);
+	stts_run--;
+
+	// Frames outside the edit are not shown
+	if (ticks < 0)
+	    continue;
+
+	t = edit_ns + gst_util_uint64_scale ((guint64) ticks, GST_SECOND, timescale);
+
+	if (GST_CLOCK_TIME_IS_VALID (edit_end) && t >= edit_end)
+	    continue;
+
+	g_array_append_val (pts, t);
+
+	if (is_key)
+	{
+	    key.pts = t;
+	    key.offset = offset;
+	    key.frame = 0;
+	    g_array_append_val (keys, key);
+	}
+    }
+
+    return (pts->len > 0) ? TRUE : FALSE;
+}
+
+
+/* Set up to walk through the samples in their chunks, FALSE (and no offsets) if the tables are not usable */
+
+static int fi_mp4_walk_init(Mp4Walk *w, guchar *stbl, guint64 stbl_len)
+{
+    guchar *p;
+    guint64 len;
+
+    memset(w, 0, sizeof(Mp4Walk));
+
+    if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','s','c'), &len)) == NULL || len < 8)
+    	return FALSE;
+
+    w->n_stsc = fi_u32(p + 4);
+    w->stsc = p + 8;
+
+    if (w->n_stsc == 0 || len < 8 + (guint64) w->n_stsc * 12)
+    	return FALSE;
+
+    if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','c','o'), &len)) != NULL && len >= 8)
+	w->co64 = FALSE;
+    else if ((p = fi_box(stbl, stbl_len, FI_ID4('c','o','6','4'), &len)) != NULL && len >= 8)
+	w->co64 = TRUE;
+    else
+    	return FALSE;
+
+    w->n_co = fi_u32(p + 4);
+    w->co = p + 8;
+
+    if (len < 8 + (guint64) w->n_co * ((w->co64) ? 8 : 4))
+    	return FALSE;
+
+    if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','s','z'), &len)) != NULL && len >= 12)
+    {
+	w->sz_bits = 32;
+	w->sz_fixed = fi_u32(p + 4);
+    }
+    else if ((p = fi_box(stbl, stbl_len, FI_ID4('s','t','z','2'), &len)) != NULL && len >= 12)
+    {
+	w->sz_bits = p[7];
+	w->sz_fixed = 0;
+    }
+    else
+    	return FALSE;
+
+    w->n_sz = fi_u32(p + 8);
+    w->sz = p + 12;
+
+    if (w->sz_bits != 4 && w->sz_bits != 8 && w->sz_bits != 16 && w->sz_bits != 32)
+    	return FALSE;
+
+    if (w->sz_fixed == 0 && len < 12 + ((guint64) w->n_sz * w->sz_bits + 7) / 8)
+    	return FALSE;
+
+    w->ok = TRUE;
+
+    return TRUE;
+}
+
+
+/* Offset of sample i (taken in turn), 0 if not known */
+
+static guint64 fi_mp4_walk_next(Mp4Walk *w, guint64 i)
+{
+    guint64 off;
+    guint32 size;
+
+    if (w->ok == FALSE || i >= w->n_sz)
+    	return 0;
+
+    /* Next chunk with any samples in it */
+    while(w->left == 0)
+    {
+	if (++w->c > w->n_co)
+	{
+	    w->ok = FALSE;
+	    return 0;
+	}
+
+	while(w->e + 1 < w->n_stsc && fi_u32(w->stsc + (w->e + 1) * 12) <= w->c)
+	    w->e++;
+
+	w->left = fi_u32(w->stsc + w->e * 12 + 4);
+	w->off = (w->co64) ? fi_u64(w->co + (w->c - 1) * 8) : fi_u32(w->co + (w->c - 1) * 4);
+    }
+
+    if (w->sz_fixed > 0)
+	size = w->sz_fixed;
+    else if (w->sz_bits == 32)
+	size = fi_u32(w->sz + i * 4);
+    else if (w->sz_bits == 16)
+	size = ((guint32) w->sz[i * 2] << 8) | w->sz[i * 2 + 1];
+    else if (w->sz_bits == 8)
+	size = w->sz[i];
+    else
+	size = (i & 1) ? (w->sz[i / 2] & 0x0f) : (w->sz[i / 2] >> 4);
+
+    off = w->off;
+    w->off += size;
+    w->left--;
+
+    return off;
+}
+
+
+/* First child box of a type, with its length (after the header) */
+
+static guchar * fi_box(guchar *p, guint64 len, guint32 type, guint64 *box_len)
+{
+    guint64 size, hdr;
+    guchar *end;
+
+    end = p + len;
+
+    while(end - p >= 8)
+    {
+	size = fi_u32(p);
+	hdr = 8;
+
+	if (size == 1)
+	{
+	    if (end - p < 16)
+		return NULL;
+
+	    size = fi_u64(p + 8);
+	    hdr = 16;
+	}
+	else if (size == 0)
+	{
+	    size = (guint64) (end - p);
+	}
+
+	if (size < hdr || size > (guint64) (end - p))
+	    return NULL;
+
+	if (fi_u32(p + 4) == type)
+	{
+	    *box_len = size - hdr;
+	    return p + hdr;
+	}
+
+	p += size;
+    }
+
+    return NULL;
+}
+
+
+static guint32 fi_u32(guchar *p)
+{
+    return ((guint32) p[0] << 24) | ((guint32) p[1] << 16) | ((guint32) p[2] << 8) | (guint32) p[3];
+}
+
+
+static guint64 fi_u64(guchar *p)
+{
+    return ((guint64) fi_u32(p) << 32) | (guint64) fi_u32(p + 4);
+}
+
+
+/***** MATROSKA *****/
+
+
+/* Read the block times and keyframes of the first video track, and the number of frames without a time of their own */
+
+static int fi_mkv(FILE *fd, GArray *pts, GArray *keys, guint64 *untimed)
+{
+    MkvScan scan;
+    guint32 id;
+    guint64 size;
+
+    memset(&scan, 0, sizeof(MkvScan));
+    scan.fd = fd;
+    scan.tc_scale = 1000000;
+    scan.pts = pts;
+    scan.keys = keys;
+
+    /* EBML header, then the segment */
+    if (fi_ebml_id(fd, &id) == FALSE || id != MKV_EBML || fi_ebml_size(fd, &size) == FALSE || size == MKV_UNKNOWN ||
+	FI_SEEK(fd, (off_t) size, SEEK_CUR) != 0)
+    	return FALSE;
+
+    if (fi_ebml_id(fd, &id) == FALSE || id != MKV_SEGMENT || fi_ebml_size(fd, &size) == FALSE)
+    	return FALSE;
+
+    if (fi_mkv_level(&scan, size, 0) == FALSE || scan.video_track == 0)
+    	return FALSE;
+
+    *untimed = scan.laced;
+
+    return (pts->len + scan.laced > 0) ? TRUE : FALSE;
+}
+
+
+/* Elements at one level, size bytes (MKV_UNKNOWN for the rest of the file) */
+
+static int fi_mkv_level(MkvScan *scan, guint64 size, int depth)
+{
+    guint32 id;
+    guint64 len, done;
+    off_t pos, start;
+
+    if (depth > FI_EBML_DEPTH)
+    	return FALSE;
+
+    done = 0;
+
+    while(size == MKV_UNKNOWN || done < size)
+    {
+	pos = FI_TELL(scan->fd);
+
+	if (fi_ebml_id(scan->fd, &id) == FALSE || fi_ebml_size(scan->fd, &len) == FALSE)
+	    return (size == MKV_UNKNOWN) ? TRUE : FALSE;
+
+	start = FI_TELL(scan->fd) - pos;
+
+	switch(id)
+	{
+	    /* Looked inside */
+	    case MKV_INFO:
+	    case MKV_TRACKS:
+	    case MKV_TRACK_ENTRY:
+	    case MKV_CLUSTER:
+	    case MKV_BLOCK_GROUP:
+		// A cluster of unknown size (live recording) ends where the next top level element starts
+		if (len == MKV_UNKNOWN)
+		    return FALSE;
+
+		if (id == MKV_TRACK_ENTRY)
+		{
+		    scan->entry_no = 0;
+		    scan->entry_video = FALSE;
+		}
+
+		if (id == MKV_BLOCK_GROUP)
+		{
+		    scan->grp_pos = pos;
+		    scan->grp_block = FALSE;
+		    scan->grp_ref = FALSE;
+		}
+
+		if (fi_mkv_level(scan, len, depth + 1) == FALSE)
+		    return FALSE;
+
+		// The first video track is the one
+		if (id == MKV_TRACK_ENTRY && scan->entry_video == TRUE && scan->video_track == 0)
+		    scan->video_track = scan->entry_no;
+
+		// A block that refers to no other is a keyframe
+		if (id == MKV_BLOCK_GROUP && scan->grp_block == TRUE && scan->grp_ref == FALSE)
+		    g_array_append_val (scan->keys, scan->grp_key);
+
+		break;
+
+	    case MKV_TC_SCALE:
+		scan->tc_scale = fi_ebml_uint(scan->fd, len);
+		break;
+
+	    case MKV_TRACK_NO:
+		scan->entry_no = fi_ebml_uint(scan->fd, len);
+		break;
+
+	    case MKV_TRACK_TYPE:
+		scan->entry_video = (fi_ebml_uint(scan->fd, len) == 1);
+		break;
+
+	    case MKV_TIMECODE:
+		scan->cluster_tc = (gint64) fi_ebml_uint(scan->fd, len);
+		break;
+
+	    case MKV_SIMPLE_BLOCK:
+	    case MKV_BLOCK:
+		if (len == MKV_UNKNOWN || fi_mkv_block(scan, id, len, pos) == FALSE)
+		    return FALSE;
+		break;
+
+	    case MKV_REF_BLOCK:
+		scan->grp_ref = TRUE;
+		break;
+
+	    default:
+		if (len == MKV_UNKNOWN || FI_SEEK(scan->fd, (off_t) len, SEEK_CUR) != 0)
+		    return FALSE;
+		break;
+	}
+
+	/* Carry on from the end of the element, whatever was read of it */
+	if (FI_SEEK(scan->fd, pos + start + (off_t) len, SEEK_SET) != 0)
+	    return FALSE;
+
+	done += start + len;
+    }
+
+    return TRUE;
+}
+
+
+/* Block header - track, time relative to the cluster and flags (a simple block says if it is a keyframe) */
+
+static int fi_mkv_block(MkvScan *scan, guint32 id, guint64 len, off_t pos)
+{
+    guint64 track;
+    guchar hdr[4];
+    gint64 tc;
+    GstClockTime t;
+    FiKey key;
+
+    if (fi_ebml_size(scan->fd, &track) == FALSE || fread(hdr, 1, 4, scan->fd) != 4)
+    	return FALSE;
+
+    if (scan->video_track == 0 || track != scan->video_track)
+    	return TRUE;
+
+    // Invisible frames are decoded but never shown
+    if (hdr[2] & 0x08)
+    	return TRUE;
+
+    /* Laced frames share one time */
+    if (hdr[2] & 0x06)
+    {
+	scan->laced += (guint64) hdr[3] + 1;
+	return TRUE;
+    }
+
+    tc = scan->cluster_tc + (gint16) (((guint16) hdr[0] << 8) | hdr[1]);
+    t = (tc > 0) ? (GstClockTime) tc * scan->tc_scale : 0;
+    g_array_append_val (scan->pts, t);
+
+    if (id == MKV_SIMPLE_BLOCK && (hdr[2] & 0x80))
+    {
+	key.pts = t;
+	key.offset = (guint64) pos;
+	key.frame = 0;
+	g_array_append_val (scan->keys, key);
+    }
+    else if (id == MKV_BLOCK)
+    {
+	scan->grp_key.pts = t;
+	scan->grp_key.offset = (guint64) scan->grp_pos;
+	scan->grp_key.frame = 0;
+	scan->grp_block = TRUE;
+    }
+
+    return TRUE;
+}
+
+
+/* Element id (marker bits kept) */
+
+static int fi_ebml_id(FILE *fd, guint32 *id)
+{
+    int c, n, i;
+
+    if ((c = fgetc(fd)) == EOF || c == 0)
+    	return FALSE;
+
+    for(n = 1; n <= 4 && (c & (0x80 >> (n - 1))) == 0; n++);
+
+    if (n > 4)
+    	return FALSE;
+
+    *id = (guint32) c;
+
+    for(i = 1; i < n; i++)
+    {
+	if ((c = fgetc(fd)) == EOF)
+	    return FALSE;
+
+	*id = (*id << 8) | (guint32) c;
+    }
+
+    return TRUE;
+}
+
+
+/* Variable length size (marker bit dropped), MKV_UNKNOWN if all ones */
+
+static int fi_ebml_size(FILE *fd, guint64 *size)
+{
+    int c, n, i, ones;
+
+    if ((c = fgetc(fd)) == EOF || c == 0)
+    	return FALSE;
+
+    for(n = 1; (c & (0x80 >> (n - 1))) == 0; n++);
+
+    *size = (guint64) (c & (0xff >> n));
+    ones = (*size == (guint64) (0xff >> n));
+
+    for(i = 1; i < n; i++)
+    {
+	if ((c = fgetc(fd)) == EOF)
+	    return FALSE;
+
+	*size = (*size << 8) | (guint64) c;
+	ones = ones && (c == 0xff);
+    }
+
+    if (ones)
+    	*size = MKV_UNKNOWN;
+
+    return TRUE;
+}
+
+
+/* Unsigned integer element */
+
+static guint64 fi_ebml_uint(FILE *fd, guint64 len)
+{
+    guint64 v;
+    int c;
+
+    v = 0;
+
+    for(; len > 0 && len <= 8; len--)
+    {
+	if ((c = fgetc(fd)) == EOF)
+	    break;
+
+	v = (v << 8) | (guint64) c;
+    }
+
+    return v;
+}
@@ -54,6 +54,8 @@ void initialise(AppData *, MainUi *);
 void final();
 
 extern void main_ui(AppData *, MainUi *);
+extern int cli_requested(int, char **);
+extern int cli_main(int, char **);
 extern void app_msg(char*, char *, GtkWidget *);
 //extern void debug_session();
 
@@ -70,6 +72,10 @@ int main(int argc, char *argv[])
     AppData app_data;
     MainUi m_ui;
 
+    /* Headless conversion - no GTK at all */
+    if (cli_requested(argc, argv) == TRUE)
+	exit(cli_main(argc, argv));
+
     /* Initial work */
     initialise(&app_data, &m_ui);
 
@@ -0,0 +1,52 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Application:	Gusto (command line only)
+**
+** Author:	Anthony Buckley
+**
+** Description:
+**  	 Headless Gusto. Built without GTK so that conversions can run on machines
+**  	 with no display and start as quickly as possible.
+**
+** History
+**	18-Oct-2026	Initial code
+**
+*/
+
+
+/* Includes */
+
+#include <stdlib.h>  
+
+
+/* Prototypes */
+
+extern int cli_main(int, char **);
+
+
+/* Main program control */
+
+int main(int argc, char *argv[])
+{  
+    exit(cli_main(argc, argv));
+}  
@@ -56,6 +56,7 @@ typedef struct _main_ui
     GtkWidget *frm_interval_lbl, *frm_interval, *int_hbox;
     GtkWidget *video_start_lbl, *video_start, *duration_lbl, *duration, *time_hbox;
     GtkWidget *codec_lbl, *codec_select_cbx;
+    GtkWidget *width_lbl, *img_width;
     GtkWidget *video_info_lbl, *txt_view, *video_frm;  
     GtkTextBuffer *txt_buffer;
     GtkWidget *video_info_vbox;
@@ -70,9 +71,5 @@ typedef struct _main_ui
     int main_height;
 
     /* Other values */
-    guint no_of_frames;
-    guint img_file_count;
-    int thread_init;
-    int seek_play;
     GdkRGBA *convbtn_bg_color;
 } MainUi;
@@ -80,6 +80,7 @@ extern void OnVideo(GtkWidget*, gpointer);
 extern void OnConvert(GtkWidget*, gpointer);
 extern void OnReset(GtkWidget*, gpointer);
 extern void OnQuit(GtkWidget*, gpointer);
+extern void gui_callbacks(AppData *, MainUi *);
 extern void set_css();
 extern char * home_dir();
 extern GtkWidget * find_widget_by_name(GtkWidget *, char *);
@@ -101,6 +102,7 @@ void main_ui(AppData *app_data, MainUi *m_ui)
     m_ui->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);  
     g_object_set_data (G_OBJECT (m_ui->window), "app_data", app_data);
     g_object_set_data (G_OBJECT (m_ui->window), "ui", m_ui);
+    gui_callbacks(app_data, m_ui);
     gtk_window_set_title(GTK_WINDOW(m_ui->window), TITLE);
     gtk_window_set_position(GTK_WINDOW(m_ui->window), GTK_WIN_POS_CENTER);
     gtk_window_set_default_size(GTK_WINDOW(m_ui->window), 500, 300);
@@ -274,10 +276,11 @@ void image_prefix_widgets(MainUi *m_ui)
 
 void video_convert_select_widgets(MainUi *m_ui)
 {  
-    const char *frame_selection_arr[] = { "Every frame", "Selected frames", "Duration (secs)", "Duration (mins)" };
-    const int frm_max = 4;
-    const char *codec_selection_arr[] = { "JPG", "PNG", "PNM", "BMP" };
-    const int codec_max = 4;
+    const char *frame_selection_arr[] = { "Every frame", "Selected frames", "Duration (secs)", "Duration (mins)", 
+    					  "Keyframes only" };
+    const int frm_max = 5;
+    const char *codec_selection_arr[] = { "JPG", "PNG", "PNM", "BMP", "RAW" };
+    const int codec_max = 5;
 
     /*Set container */
     m_ui->frm_grid = gtk_grid_new();
@@ -340,6 +343,18 @@ void video_convert_select_widgets(MainUi *m_ui)
     create_cbox(&(m_ui->codec_select_cbx), "codec_sel", codec_selection_arr, codec_max, 0, m_ui->frm_grid, 4, 0);
     gtk_widget_set_margin_left(m_ui->codec_select_cbx, 10);
 
+    /* Output image width */
+    create_label2(&(m_ui->width_lbl), "title_4", "Width", m_ui->frm_grid, 5, 0, 1, 1);
+    gtk_widget_set_margin_left(m_ui->width_lbl, 10);
+
+    m_ui->img_width = gtk_entry_new();
+    gtk_widget_set_name(m_ui->img_width, "ent_1");
+    gtk_entry_set_width_chars(GTK_ENTRY (m_ui->img_width), 4);
+    gtk_widget_set_margin_left(m_ui->img_width, 10);
+    gtk_widget_set_tooltip_text (m_ui->img_width, "Enter '0' for the video size.");
+    gtk_entry_set_text(GTK_ENTRY (m_ui->img_width), "0");
+    gtk_grid_attach(GTK_GRID (m_ui->frm_grid), m_ui->img_width, 6, 0, 1, 1);
+
     return;
 }
 
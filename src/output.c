@@ -0,0 +1,677 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Frame pool output other than one file per image.
+**		RAW - decoded frames in a fixed pixel format (RGB24, GRAY8 or I420), one after
+**		another in a single preallocated, memory mapped file. A small header starts the
+**		file and an index of frame offsets and times sits alongside it. Each frame has
+**		a fixed slot, so the workers copy into the map at the same time.
+**		Pack - the encoded images are appended in frame order to one uncompressed tar
+**		archive (or stdout), with an index as the last member.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Pack (tar) output
+**	18-Oct-2026	RAW file sized for the images converted, not the whole video
+**	18-Oct-2026	Frame size change reported once
+**
+*/
+
+
+
+/* Defines */
+
+#define RAW_MAGIC "GUSTORAW"
+#define RAW_VERSION 1
+#define RAW_HDR_SZ 64			// Frames start here
+#define RAW_INIT_FRAMES 256		// Room for this many if the frame count is not known
+#define TAR_BLOCK 512
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#else
+#include <io.h>
+#endif
+
+
+/* Typedefs */
+
+typedef struct _raw_dump
+{
+    int fd;
+    char *fn;				/* Frames file */
+    char *idx_fn;			/* Index file */
+    pthread_rwlock_t lock;		/* Write lock only to set up or grow the map */
+    guchar *map;
+    guint64 frame_size;			/* Packed frame bytes, 0 until the first frame */
+    int width, height;
+    guint64 capacity;			/* Frames the file has room for */
+    guint64 *pts;			/* Frame times, by slot */
+    gint bad_size;			/* A frame of another size has been reported */
+} RawDump;
+
+typedef struct _pack_out
+{
+    FILE *fd;				/* Archive (may be stdout) */
+    char *fn;
+    guint64 offset;			/* Bytes written so far */
+    GString *index;			/* Name, data offset and size of each image */
+    char name[100];			/* Member name buffer */
+    const char *tmpl;			/* Member name template (the image file name) */
+} PackOut;
+
+
+/* Prototypes */
+
+const char * output_format(AppData *);
+int output_open(AppData *);
+int output_close(AppData *, int);
+int output_write(AppData *, guint, EncBuf *);
+static int raw_open(AppData *);
+static int raw_close(AppData *, int);
+int raw_frame(AppData *, GstSample *, guint);
+static int raw_setup(AppData *, RawDump *, GstVideoInfo *);
+static int raw_grow(RawDump *, guint64);
+static int raw_header(AppData *, RawDump *, guint64);
+static int raw_index(AppData *, RawDump *, guint64);
+static guint64 raw_frame_size(GstVideoInfo *);
+static void raw_pack(guchar *, guint8 *, GstVideoInfo *);
+static int pack_open(AppData *);
+static int pack_close(AppData *, int);
+static int pack_member(PackOut *, const char *, guchar *, gsize, guchar *, gsize);
+
+extern void eng_msg(AppData *, char *, char *);
+extern guint frames_to_convert(AppData *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-output.c ";
+static const char *raw_format_arr[] = { "RGB", "GRAY8", "I420" };	// enum raw_fmt
+
+
+/* Raw video format the output needs, if it is not an image encoder */
+
+const char * output_format(AppData *app_data)
+{
+    return raw_format_arr[app_data->raw_fmt];
+}
+
+
+/* Open the output for the conversion (nothing needed for image files) */
+
+int output_open(AppData *app_data)
+{
+    app_data->out_file = NULL;
+
+    if (app_data->codec_idx == CODEC_RAW)
+    	return raw_open(app_data);
+
+    if (app_data->pack_fn != NULL)
+    	return pack_open(app_data);
+
+    return TRUE;
+}
+
+
+/* Finish the output. Returns ok, or FALSE if the output could not be completed. */
+
+int output_close(AppData *app_data, int ok)
+{
+    if (app_data->out_file == NULL)
+    	return ok;
+
+    if (app_data->codec_idx == CODEC_RAW)
+    	return raw_close(app_data, ok);
+
+    return pack_close(app_data, ok);
+}
+
+
+/* Write an encoded image to the single file output - in frame order, one at a time (pool turnstile) */
+
+int output_write(AppData *app_data, guint seq, EncBuf *buf)
+{
+    PackOut *pack;
+    guint64 data_off;
+
+    pack = (PackOut *) app_data->out_file;
+
+    snprintf(pack->name, sizeof(pack->name), pack->tmpl, app_data->start_index + seq);
+    data_off = pack->offset + TAR_BLOCK;
+
+    if (pack_member(pack, pack->name, buf->data, buf->len, buf->body, buf->body_len) == FALSE)
+    	return FALSE;
+
+    g_string_append_printf (pack->index, "%s %" G_GUINT64_FORMAT " %" G_GSIZE_FORMAT "\n", 
+    			    pack->name, data_off, buf->len + buf->body_len);
+
+    return TRUE;
+}
+
+
+/***** RAW *****/
+
+
+/* Create the frames file */
+
+static int raw_open(AppData *app_data)
+{
+    RawDump *dump;
+
+    dump = (RawDump *) malloc(sizeof(RawDump));
+    memset(dump, 0, sizeof(RawDump));
+
+    dump->fn = (char *) malloc(strlen(app_data->output_dir) + strlen(app_data->img_prefix) + 20);
+    sprintf(dump->fn, "%s/%sframes.raw", app_data->output_dir, app_data->img_prefix);
+    dump->idx_fn = (char *) malloc(strlen(dump->fn) + 1);
+    sprintf(dump->idx_fn, "%s/%sframes.idx", app_data->output_dir, app_data->img_prefix);
+
+    #ifdef __linux__
+	dump->fd = open(dump->fn, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    #else
+	dump->fd = open(dump->fn, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    #endif
+
+    if (dump->fd < 0)
+    {
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", dump->fn, errno, strerror(errno));
+	eng_msg(app_data, "MSG0007", "raw frames file");
+	free(dump->fn);
+	free(dump->idx_fn);
+	free(dump);
+	return FALSE;
+    }
+
+    pthread_rwlock_init(&(dump->lock), NULL);
+    app_data->out_file = (void *) dump;
+
+    return TRUE;
+}
+
+
+/* All frames are in - trim the file to the frames written, set the header and write the index */
+
+static int raw_close(AppData *app_data, int ok)
+{
+    RawDump *dump;
+    guint64 n_frames;
+
+    dump = (RawDump *) app_data->out_file;
+
+    // Frames are committed in order, so these are all complete
+    n_frames = app_data->img_file_count;
+
+    #ifdef __linux__
+	if (dump->map != NULL)
+	    munmap(dump->map, RAW_HDR_SZ + dump->capacity * dump->frame_size);
+    #endif
+
+    if (ftruncate(dump->fd, (off_t) (RAW_HDR_SZ + n_frames * dump->frame_size)) != 0)
+    	ok = FALSE;
+
+    if (raw_header(app_data, dump, n_frames) == FALSE)
+    	ok = FALSE;
+
+    if (close(dump->fd) != 0)
+    	ok = FALSE;
+
+    if (ok == TRUE && raw_index(app_data, dump, n_frames) == FALSE)
+    {
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", dump->idx_fn, errno, strerror(errno));
+	eng_msg(app_data, "MSG0007", "raw frames index");
+	ok = FALSE;
+    }
+
+    pthread_rwlock_destroy(&(dump->lock));
+    free(dump->pts);
+    free(dump->fn);
+    free(dump->idx_fn);
+    free(dump);
+    app_data->out_file = NULL;
+
+    return ok;
+}
+
+
+/* Copy a frame into its slot (called by the pool workers at the same time) */
+
+int raw_frame(AppData *app_data, GstSample *sample, guint seq)
+{
+    RawDump *dump;
+    GstBuffer *buffer;
+    GstMapInfo map;
+    GstVideoInfo info;
+    guint64 slot;
+    int ok;
+
+    dump = (RawDump *) app_data->out_file;
+    buffer = gst_sample_get_buffer (sample);
+
+    if (dump == NULL || buffer == NULL || ! gst_video_info_from_caps (&info, gst_sample_get_caps (sample)))
+    	return FALSE;
+
+    if (! gst_buffer_map (buffer, &map, GST_MAP_READ))
+    	return FALSE;
+
+    slot = (guint64) app_data->start_index + seq;
+    ok = TRUE;
+
+    /* Set up on the first frame and grow the file when full (no one may copy meanwhile) */
+    pthread_rwlock_rdlock(&(dump->lock));
+
+    while(ok == TRUE && (dump->frame_size == 0 || slot >= dump->capacity))
+    {
+	pthread_rwlock_unlock(&(dump->lock));
+	pthread_rwlock_wrlock(&(dump->lock));
+
+	if (dump->frame_size == 0)
+	    ok = raw_setup(app_data, dump, &info);
+
+	if (ok == TRUE && slot >= dump->capacity)
+	    ok = raw_grow(dump, MAX (slot + 1, dump->capacity * 2));
+
+	pthread_rwlock_unlock(&(dump->lock));
+	pthread_rwlock_rdlock(&(dump->lock));
+    }
+
+    // Every frame must be the same size to have a fixed slot (the workers all see it, only one says so)
+    if (ok == TRUE && (GST_VIDEO_INFO_WIDTH (&info) != dump->width || GST_VIDEO_INFO_HEIGHT (&info) != dump->height))
+    {
+	if (g_atomic_int_compare_and_exchange (&(dump->bad_size), 0, 1))
+	    sprintf(app_msg_extra, "Frame size changed from %dx%d\n", dump->width, dump->height);
+
+	ok = FALSE;
+    }
+
+    if (ok == TRUE)
+    {
+	dump->pts[slot] = GST_BUFFER_PTS (buffer);
+
+	#ifdef __linux__
+	    raw_pack(dump->map + RAW_HDR_SZ + slot * dump->frame_size, map.data, &info);
+	#else
+	{
+	    guchar *tmp;
+
+	    tmp = (guchar *) malloc(dump->frame_size);
+	    raw_pack(tmp, map.data, &info);
+	    ok = (lseek(dump->fd, (off_t) (RAW_HDR_SZ + slot * dump->frame_size), SEEK_SET) >= 0 && 
+		  write(dump->fd, tmp, dump->frame_size) == (int) dump->frame_size);
+	    free(tmp);
+	}
+	#endif
+    }
+
+    pthread_rwlock_unlock(&(dump->lock));
+    gst_buffer_unmap (buffer, &map);
+
+    return ok;
+}
+
+
+/* First frame - the frame size is fixed from here on */
+
+static int raw_setup(AppData *app_data, RawDump *dump, GstVideoInfo *info)
+{
+    guint64 n, fi;
+
+    dump->width = GST_VIDEO_INFO_WIDTH (info);
+    dump->height = GST_VIDEO_INFO_HEIGHT (info);
+    dump->frame_size = raw_frame_size(info);
+
+    /* Room for the images this run writes, not every frame in the video (a little over is trimmed at the end) */
+    fi = (guint64) MAX(1, app_data->frame_interval);
+
+    if (app_data->seg_no > 0)
+	n = ((guint64) app_data->no_of_frames + fi - 1) / fi;
+    else
+	n = (guint64) frames_to_convert(app_data);
+
+    // The file grows as needed if the count is not known
+    n = (n > 0) ? (guint64) app_data->start_index + n + 1 : RAW_INIT_FRAMES;
+
+    return raw_grow(dump, n);
+}
+
+
+/* Make the file big enough for n frames and map it again */
+
+static int raw_grow(RawDump *dump, guint64 n)
+{
+    guint64 *pts;
+    off_t len;
+    int r;
+
+    len = (off_t) (RAW_HDR_SZ + n * dump->frame_size);
+
+    #ifdef __linux__
+	if (dump->map != NULL)
+	{
+	    munmap(dump->map, RAW_HDR_SZ + dump->capacity * dump->frame_size);
+	    dump->map = NULL;
+	}
+
+	// Allocate the blocks now so the copies are not held up (and a full disk shows up here)
+	if ((r = posix_fallocate(dump->fd, 0, len)) == ENOSPC)
+	    return FALSE;
+
+	if (r != 0 && ftruncate(dump->fd, len) != 0)
+	    return FALSE;
+
+	dump->map = (guchar *) mmap(NULL, (size_t) len, PROT_READ | PROT_WRITE, MAP_SHARED, dump->fd, 0);
+
+	if (dump->map == MAP_FAILED)
+	{
+	    dump->map = NULL;
+	    return FALSE;
+	}
+
+	madvise(dump->map, (size_t) len, MADV_SEQUENTIAL);
+    #else
+	if (ftruncate(dump->fd, len) != 0)
+	    return FALSE;
+    #endif
+
+    if ((pts = (guint64 *) realloc(dump->pts, sizeof(guint64) * n)) == NULL)
+    	return FALSE;
+
+    memset(pts + dump->capacity, 0xff, sizeof(guint64) * (n - dump->capacity));
+    dump->pts = pts;
+    dump->capacity = n;
+
+    return TRUE;
+}
+
+
+/* 
+    File header (little endian)
+	0   "GUSTORAW"
+	8   version, format (0 RGB24, 1 GRAY8, 2 I420), width, height	(4 bytes each)
+	24  frame size, frame count					(8 bytes each)
+	40  frame rate numerator, denominator, header size		(4 bytes each)
+	52  reserved
+*/
+
+static int raw_header(AppData *app_data, RawDump *dump, guint64 n_frames)
+{
+    guchar hdr[RAW_HDR_SZ];
+    guint32 v32[3];
+    guint64 v64[2];
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, RAW_MAGIC, 8);
+
+    v32[0] = GUINT32_TO_LE (RAW_VERSION);
+    v32[1] = GUINT32_TO_LE ((guint32) app_data->raw_fmt);
+    v32[2] = GUINT32_TO_LE ((guint32) dump->width);
+    memcpy(hdr + 8, v32, 12);
+    v32[0] = GUINT32_TO_LE ((guint32) dump->height);
+    memcpy(hdr + 20, v32, 4);
+
+    v64[0] = GUINT64_TO_LE (dump->frame_size);
+    v64[1] = GUINT64_TO_LE (n_frames);
+    memcpy(hdr + 24, v64, 16);
+
+    v32[0] = GUINT32_TO_LE (app_data->fr_num);
+    v32[1] = GUINT32_TO_LE (app_data->fr_denom);
+    v32[2] = GUINT32_TO_LE (RAW_HDR_SZ);
+    memcpy(hdr + 40, v32, 12);
+
+    if (lseek(dump->fd, 0, SEEK_SET) != 0)
+    	return FALSE;
+
+    return (write(dump->fd, hdr, sizeof(hdr)) == (int) sizeof(hdr));
+}
+
+
+/* Index - one line per frame: number, offset in the frames file and time (ns, -1 if unknown) */
+
+static int raw_index(AppData *app_data, RawDump *dump, guint64 n_frames)
+{
+    FILE *fd;
+    guint64 i;
+    int ok;
+
+    if ((fd = fopen(dump->idx_fn, "w")) == NULL)
+    	return FALSE;
+
+    fprintf(fd, "# %s %dx%d %s frame_size %" G_GUINT64_FORMAT "\n", RAW_MAGIC, dump->width, dump->height, 
+    		raw_format_arr[app_data->raw_fmt], dump->frame_size);
+    fprintf(fd, "# frame offset pts_ns\n");
+
+    for(i = 0; i < n_frames; i++)
+    {
+	fprintf(fd, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT "\n", 
+		i, RAW_HDR_SZ + i * dump->frame_size, 
+		(dump->pts[i] == GST_CLOCK_TIME_NONE) ? (gint64) -1 : (gint64) dump->pts[i]);
+    }
+
+    ok = (ferror(fd) == 0);
+
+    if (fclose(fd) != 0)
+    	ok = FALSE;
+
+    return ok;
+}
+
+
+/* Bytes in a frame with the planes packed and no row padding */
+
+static guint64 raw_frame_size(GstVideoInfo *info)
+{
+    guint64 sz;
+    guint p;
+
+    for(p = 0, sz = 0; p < GST_VIDEO_INFO_N_PLANES (info); p++)
+	sz += (guint64) GST_VIDEO_INFO_COMP_WIDTH (info, p) * GST_VIDEO_INFO_COMP_PSTRIDE (info, p) * 
+	      GST_VIDEO_INFO_COMP_HEIGHT (info, p);
+
+    return sz;
+}
+
+
+/* Copy a frame, removing any row padding */
+
+static void raw_pack(guchar *out, guint8 *data, GstVideoInfo *info)
+{
+    guint8 *row;
+    gsize row_bytes;
+    guint p;
+    int y;
+
+    for(p = 0; p < GST_VIDEO_INFO_N_PLANES (info); p++)
+    {
+	row = data + GST_VIDEO_INFO_PLANE_OFFSET (info, p);
+	row_bytes = (gsize) GST_VIDEO_INFO_COMP_WIDTH (info, p) * GST_VIDEO_INFO_COMP_PSTRIDE (info, p);
+
+	for(y = 0; y < GST_VIDEO_INFO_COMP_HEIGHT (info, p); y++)
+	{
+	    memcpy(out, row, row_bytes);
+	    out += row_bytes;
+	    row += GST_VIDEO_INFO_PLANE_STRIDE (info, p);
+	}
+    }
+
+    return;
+}
+
+
+/***** PACK *****/
+
+
+/* Create the archive ("-" is stdout) */
+
+static int pack_open(AppData *app_data)
+{
+    PackOut *pack;
+    char *p;
+
+    pack = (PackOut *) malloc(sizeof(PackOut));
+    memset(pack, 0, sizeof(PackOut));
+
+    if (strcmp(app_data->pack_fn, "-") == 0)
+    {
+	pack->fd = stdout;
+
+	#ifndef __linux__
+	    _setmode(_fileno(stdout), _O_BINARY);
+	#endif
+    }
+    else if ((pack->fd = fopen(app_data->pack_fn, "wb")) == NULL)
+    {
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", app_data->pack_fn, errno, strerror(errno));
+	eng_msg(app_data, "MSG0007", "archive");
+	free(pack);
+	return FALSE;
+    }
+
+    // Members are named as the image files would be, without the directory
+    p = strrchr(app_data->filenm_tmpl, '/');
+    pack->tmpl = (p != NULL) ? p + 1 : app_data->filenm_tmpl;
+    pack->fn = app_data->pack_fn;
+    pack->index = g_string_new (NULL);
+    app_data->out_file = (void *) pack;
+
+    return TRUE;
+}
+
+
+/* Add the index as the last member and end the archive */
+
+static int pack_close(AppData *app_data, int ok)
+{
+    PackOut *pack;
+    guchar end[TAR_BLOCK * 2];
+
+    pack = (PackOut *) app_data->out_file;
+
+    if (ok == TRUE)
+    {
+	snprintf(pack->name, sizeof(pack->name), "%sindex.txt", app_data->img_prefix);
+	ok = pack_member(pack, pack->name, (guchar *) pack->index->str, pack->index->len, NULL, 0);
+    }
+
+    // End of archive - two empty blocks (also closes off a failed archive so it can be read)
+    memset(end, 0, sizeof(end));
+
+    if (fwrite(end, 1, sizeof(end), pack->fd) != sizeof(end))
+    	ok = FALSE;
+
+    if (pack->fd == stdout)
+    {
+	if (fflush(pack->fd) != 0)
+	    ok = FALSE;
+    }
+    else if (fclose(pack->fd) != 0)
+    {
+	ok = FALSE;
+    }
+
+    if (ok == FALSE)
+    {
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", pack->fn, errno, strerror(errno));
+	eng_msg(app_data, "MSG0007", "archive");
+    }
+
+    g_string_free (pack->index, TRUE);
+    free(pack);
+    app_data->out_file = NULL;
+
+    return ok;
+}
+
+
+/* Write a tar (ustar) member - header, data (in two parts) and padding to a block */
+
+static int pack_member(PackOut *pack, const char *name, guchar *data, gsize len, guchar *data2, gsize len2)
+{
+    guchar hdr[TAR_BLOCK];
+    guchar pad[TAR_BLOCK];
+    gsize size, n_pad;
+    guint sum;
+    int i;
+
+    size = len + len2;
+
+    memset(hdr, 0, sizeof(hdr));
+    strncpy((char *) hdr, name, 99);					// Name
+    memcpy(hdr + 100, "0000644", 7);					// Mode
+    memcpy(hdr + 108, "0000000", 7);					// Uid
+    memcpy(hdr + 116, "0000000", 7);					// Gid
+    sprintf((char *) hdr + 124, "%011" G_GINT64_MODIFIER "o", (guint64) size);	// Size
+    sprintf((char *) hdr + 136, "%011lo", (unsigned long) time(NULL));	// Modified
+    hdr[156] = '0';							// Regular file
+    memcpy(hdr + 257, "ustar", 6);					// Magic
+    memcpy(hdr + 263, "00", 2);						// Version
+
+    // Checksum is taken with its own field as spaces
+    memset(hdr + 148, ' ', 8);
+
+    for(i = 0, sum = 0; i < TAR_BLOCK; i++)
+    	sum += hdr[i];
+
+    sprintf((char *) hdr + 148, "%06o", sum);
+    hdr[155] = ' ';
+
+    if (fwrite(hdr, 1, TAR_BLOCK, pack->fd) != TAR_BLOCK)
+    	return FALSE;
+
+    if (len > 0 && fwrite(data, 1, len, pack->fd) != len)
+    	return FALSE;
+
+    if (len2 > 0 && fwrite(data2, 1, len2, pack->fd) != len2)
+    	return FALSE;
+
+    n_pad = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    memset(pad, 0, n_pad);
+
+    if (n_pad > 0 && fwrite(pad, 1, n_pad, pack->fd) != n_pad)
+    	return FALSE;
+
+    pack->offset += TAR_BLOCK + size + n_pad;
+
+    return TRUE;
+}
@@ -0,0 +1,777 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Frame pool. Raw frames are taken from an appsink and handed to a number of
+**		worker threads, each of which encodes with a native encoder (encoders.c).
+**		Frames are numbered as they arrive, so the file numbering is the same as a
+**		single encoder would give. Separate image files are written as soon as they
+**		are encoded (so several disks can be busy at once), normally by handing them
+**		to the write-behind writer (writer.c), and a turnstile then
+**		counts them in frame order. Output to a single file is written under the
+**		turnstile, in frame order, so it can be streamed.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Frame data may be written straight from the sample (BMP)
+**	18-Oct-2026	RAW frames go into a single file (output.c)
+**	18-Oct-2026	Images may be packed into an archive (output.c)
+**	18-Oct-2026	Sharded directories made as they are reached
+**	18-Oct-2026	Images striped over several directories, with a manifest
+**	18-Oct-2026	Image files handed to a write-behind writer (writer.c)
+**	18-Oct-2026	Disk monitor - pause before the output disk is full
+**	18-Oct-2026	Manifest added to when resuming
+**	18-Oct-2026	Worker failures kept in the pool, not written to app_msg_extra
+**
+*/
+
+
+
+/* Defines */
+
+#define QUEUE_PER_WORKER 2		// Frames waiting per worker before the pipeline is held up
+#define STRIPE_CHECK 256		// Images between free space checks when striping by space
+#define DISK_CHECK 1000000		// Time (usecs) between output disk free space checks
+#define DISK_RESERVE 256		// Default MB to leave free on the output disk
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/statvfs.h>
+#endif
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _frame_job
+{
+    GstSample *sample;
+    guint seq;				/* Arrival order, from 0 */
+} FrameJob;
+
+typedef struct _frame_pool
+{
+    AppData *app_data;
+    pthread_t *tids;
+    int n_workers;
+    GQueue *queue;			/* Frames waiting to be encoded */
+    int max_queue;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond_job;		/* A frame is waiting or the pool is stopping */
+    pthread_cond_t cond_space;		/* There is room in the queue */
+    pthread_cond_t cond_turn;		/* The next frame may be written */
+    guint next_seq;			/* Given to the next frame to arrive */
+    guint commit_seq;			/* Next frame to be written */
+    int stopping;			/* No more frames coming, finish the queue */
+    int abort;				/* Stop now */
+    int failed;
+    pthread_mutex_t dir_mtx;		/* Shard and stripe details below */
+    guint64 *shard;			/* Last shard directory known to exist, per stripe */
+    gint64 *weight;			/* Free space (MB) per stripe when striping by space */
+    gint64 *current;			/* Smooth weighted round-robin totals */
+    guint picks;			/* Stripes chosen by space */
+    FILE *manifest;			/* Where each image went when striping */
+    gint64 t_disk;			/* Last free space check */
+    char *disk_dir;			/* Directory of a single output file, if not output_dir */
+    guint64 bytes_out;			/* Image bytes so far, for the average size */
+    int paused;				/* Output disk nearly full, take no more frames */
+    char err_txt[256];			/* First worker failure, given to app_msg_extra at the end */
+} FramePool;
+
+
+/* Prototypes */
+
+int pool_start(AppData *);
+void pool_abort(AppData *);
+int pool_stop(AppData *, int);
+static GstFlowReturn pool_new_sample(GstAppSink *, gpointer);
+static void * pool_worker(void *);
+static int pool_write(FramePool *, guint, EncBuf *, char *);
+static int pool_shard_dir(FramePool *, int, guint64, char *);
+static void pool_error(FramePool *, const char *, char *, int);
+static int pool_stripe(FramePool *, guint64);
+static void pool_space(FramePool *);
+static gint64 pool_free_mb(char *);
+static int pool_disk_low(FramePool *);
+static void pool_pause_state(FramePool *);
+static int pool_manifest_open(FramePool *);
+
+extern int encode_frame(AppData *, GstSample *, EncBuf *);
+extern void encode_done(EncBuf *);
+extern int output_open(AppData *);
+extern int output_close(AppData *, int);
+extern int raw_frame(AppData *, GstSample *, guint);
+extern int output_write(AppData *, guint, EncBuf *);
+extern void eng_msg(AppData *, char *, char *);
+extern int check_dir(char *);
+extern int make_dir(char *);
+extern int writer_open(AppData *);
+extern int writer_submit(AppData *, char *, EncBuf *);
+extern int writer_close(AppData *, int);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-pool.c ";
+
+
+/* Set up the pool on the appsink and start the workers */
+
+int pool_start(AppData *app_data)
+{
+    FramePool *pool;
+    GstAppSinkCallbacks cbs;
+    int i, n, p_err;
+
+    if (output_open(app_data) == FALSE)
+    	return FALSE;
+
+    pool = (FramePool *) malloc(sizeof(FramePool));
+    memset(pool, 0, sizeof(FramePool));
+    pool->app_data = app_data;
+    pool->n_workers = (app_data->enc_threads > 0) ? app_data->enc_threads : (int) g_get_num_processors ();
+    pool->max_queue = pool->n_workers * QUEUE_PER_WORKER;
+    pool->queue = g_queue_new ();
+    pthread_mutex_init(&(pool->mtx), NULL);
+    pthread_cond_init(&(pool->cond_job), NULL);
+    pthread_cond_init(&(pool->cond_space), NULL);
+    pthread_cond_init(&(pool->cond_turn), NULL);
+    pool->tids = (pthread_t *) malloc(sizeof(pthread_t) * pool->n_workers);
+    pthread_mutex_init(&(pool->dir_mtx), NULL);
+    n = MAX(1, app_data->n_out_dirs);
+    pool->shard = (guint64 *) malloc(sizeof(guint64) * n);
+    pool->weight = (gint64 *) malloc(sizeof(gint64) * n);
+    pool->current = (gint64 *) malloc(sizeof(gint64) * n);
+
+    for(i = 0; i < n; i++)
+    {
+	pool->shard[i] = G_MAXUINT64;
+	pool->weight[i] = 1;
+	pool->current[i] = 0;
+    }
+
+    app_data->pool = (void *) pool;
+
+    // An archive is checked where it is, there is no telling for stdout
+    if (app_data->pack_fn != NULL && strcmp(app_data->pack_fn, "-") != 0)
+	pool->disk_dir = g_path_get_dirname (app_data->pack_fn);
+
+    if (app_data->n_out_dirs > 1 && app_data->out_file == NULL && pool_manifest_open(pool) == FALSE)
+    {
+	eng_msg(app_data, "MSG0007", "manifest");
+	pool->n_workers = 0;
+	pool_stop(app_data, FALSE);
+	return FALSE;
+    }
+
+    // The workers go on to the next frame while their image files are written
+    if (app_data->out_file == NULL && app_data->sync_write == FALSE && writer_open(app_data) == FALSE)
+    {
+	pool->n_workers = 0;
+	pool_stop(app_data, FALSE);
+	return FALSE;
+    }
+
+    /* Frames are pushed to the pool from the streaming thread */
+    memset(&cbs, 0, sizeof(GstAppSinkCallbacks));
+    cbs.new_sample = pool_new_sample;
+    gst_app_sink_set_callbacks (GST_APP_SINK (app_data->gst_objs.a_sink), &cbs, pool, NULL);
+
+    for(i = 0; i < pool->n_workers; i++)
+    {
+	if ((p_err = pthread_create(&(pool->tids[i]), NULL, pool_worker, (void *) pool)) != 0)
+	{
+	    sprintf(app_msg_extra, "Error: %s", strerror(p_err));
+	    eng_msg(app_data, "MSG9017", NULL);
+	    pool->n_workers = i;
+	    pool_stop(app_data, FALSE);
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
+
+/* Abandon the frames - releases the streaming thread if it is waiting for room in the queue */
+
+void pool_abort(AppData *app_data)
+{
+    FramePool *pool;
+
+    if ((pool = (FramePool *) app_data->pool) == NULL)
+    	return;
+
+    pthread_mutex_lock(&(pool->mtx));
+    pool->abort = TRUE;
+    pthread_cond_broadcast(&(pool->cond_job));
+    pthread_cond_broadcast(&(pool->cond_space));
+    pthread_cond_broadcast(&(pool->cond_turn));
+    pthread_mutex_unlock(&(pool->mtx));
+
+    return;
+}
+
+
+/* Stop the pool - either finish the frames already queued or abandon them. FALSE if any failed. */
+
+int pool_stop(AppData *app_data, int drain)
+{
+    FramePool *pool;
+    FrameJob *job;
+    int i, ok;
+
+    if ((pool = (FramePool *) app_data->pool) == NULL)
+    	return TRUE;
+
+    pthread_mutex_lock(&(pool->mtx));
+
+    if (drain == TRUE)
+	pool->stopping = TRUE;
+    else
+	pool->abort = TRUE;
+
+    pthread_cond_broadcast(&(pool->cond_job));
+    pthread_cond_broadcast(&(pool->cond_space));
+    pthread_cond_broadcast(&(pool->cond_turn));
+    pthread_mutex_unlock(&(pool->mtx));
+
+    for(i = 0; i < pool->n_workers; i++)
+	pthread_join(pool->tids[i], NULL);
+
+    /* Anything left over was abandoned */
+    while((job = (FrameJob *) g_queue_pop_head (pool->queue)) != NULL)
+    {
+	gst_sample_unref (job->sample);
+	free(job);
+    }
+
+    if (writer_close(app_data, (pool->failed == FALSE && pool->abort == FALSE)) == FALSE)
+	pool->failed = TRUE;
+
+    ok = (pool->failed == FALSE && pool->abort == FALSE);
+    ok = output_close(app_data, ok);
+
+    if (pool->manifest != NULL && fclose(pool->manifest) != 0)
+    	ok = FALSE;
+
+    if (pool->failed == TRUE)
+    {
+	if (pool->err_txt[0] != '\0')
+	    strcpy(app_msg_extra, pool->err_txt);
+
+	eng_msg(app_data, "MSG0007", "write failed");
+    }
+    else if (pool->paused == TRUE)
+    {
+	// Everything before the pause is written, so the conversion can be taken up from there
+	char s[20];
+
+	ok = FALSE;
+	pool_pause_state(pool);
+	sprintf(s, "%u", pool->commit_seq);
+	eng_msg(app_data, "MSG0012", s);
+    }
+
+    g_queue_free (pool->queue);
+    pthread_mutex_destroy(&(pool->mtx));
+    pthread_cond_destroy(&(pool->cond_job));
+    pthread_cond_destroy(&(pool->cond_space));
+    pthread_cond_destroy(&(pool->cond_turn));
+    pthread_mutex_destroy(&(pool->dir_mtx));
+    free(pool->tids);
+    free(pool->shard);
+    free(pool->weight);
+    free(pool->current);
+    g_free (pool->disk_dir);
+    free(pool);
+    app_data->pool = NULL;
+
+    return ok;
+}
+
+
+/* New frame at the appsink - number it and queue it, waiting if the workers are behind */
+
+static GstFlowReturn pool_new_sample(GstAppSink *sink, gpointer user_data)
+{
+    FramePool *pool;
+    FrameJob *job;
+    GstSample *sample;
+
+    pool = (FramePool *) user_data;
+
+    if ((sample = gst_app_sink_pull_sample (sink)) == NULL)
+    	return GST_FLOW_ERROR;
+
+    // Output disk nearly full - the frames already taken are finished and the pipeline sees the end
+    // (the demuxer answers the EOS flow return with an EOS event, which ends the conversion).
+    // Only frame pool formats are checked, PNM goes to multifilesink and is not paused.
+    if (pool->paused == FALSE && pool_disk_low(pool) == TRUE)
+    	pool->paused = TRUE;
+
+    if (pool->paused == TRUE)
+    {
+	gst_sample_unref (sample);
+	return GST_FLOW_EOS;
+    }
+
+    pthread_mutex_lock(&(pool->mtx));
+
+    while(g_queue_get_length (pool->queue) >= pool->max_queue && pool->abort == FALSE)
+	pthread_cond_wait(&(pool->cond_space), &(pool->mtx));
+
+    if (pool->abort == TRUE || pool->failed == TRUE)
+    {
+	pthread_mutex_unlock(&(pool->mtx));
+	gst_sample_unref (sample);
+	return GST_FLOW_ERROR;
+    }
+
+    job = (FrameJob *) malloc(sizeof(FrameJob));
+    job->sample = sample;
+    job->seq = pool->next_seq++;
+    g_queue_push_tail (pool->queue, job);
+
+    pthread_cond_signal(&(pool->cond_job));
+    pthread_mutex_unlock(&(pool->mtx));
+
+    return GST_FLOW_OK;
+}
+
+
+/* Worker - encode and write frames, then wait for the turn to count them (or write a single file) */
+
+static void * pool_worker(void *arg)
+{
+    FramePool *pool;
+    FrameJob *job;
+    EncBuf buf;
+    char *fn;
+    gsize len, dir_len;
+    int i, ok;
+
+    pool = (FramePool *) arg;
+    memset(&buf, 0, sizeof(EncBuf));
+
+    // A striped template has the directory put in, so allow for the longest one
+    dir_len = 0;
+
+    for(i = 0; pool->app_data->n_out_dirs > 1 && i < pool->app_data->n_out_dirs; i++)
+	dir_len = MAX(dir_len, strlen(pool->app_data->out_dirs[i]));
+
+    fn = (char *) malloc(strlen(pool->app_data->filenm_tmpl) + dir_len + 40);
+
+    while(1)
+    {
+	pthread_mutex_lock(&(pool->mtx));
+
+	while(g_queue_is_empty (pool->queue) && pool->stopping == FALSE && pool->abort == FALSE)
+	    pthread_cond_wait(&(pool->cond_job), &(pool->mtx));
+
+	if (pool->abort == TRUE || g_queue_is_empty (pool->queue))
+	{
+	    pthread_mutex_unlock(&(pool->mtx));
+	    break;
+	}
+
+	job = (FrameJob *) g_queue_pop_head (pool->queue);
+	pthread_cond_signal(&(pool->cond_space));
+	pthread_mutex_unlock(&(pool->mtx));
+
+	/* Encode (all workers at once) - RAW frames go straight into their place in the output */
+	if (pool->app_data->codec_idx == CODEC_RAW)
+	{
+	    ok = raw_frame(pool->app_data, job->sample, job->seq);
+	    len = 0;
+	}
+	else
+	{
+	    ok = encode_frame(pool->app_data, job->sample, &buf);
+	    len = buf.len + buf.body_len;
+
+	    // Image files may be written in any order
+	    if (ok == TRUE && pool->app_data->out_file == NULL)
+		ok = pool_write(pool, job->seq, &buf, fn);
+	}
+
+	/* Turnstile - count (and write a single output file) in arrival order */
+	pthread_mutex_lock(&(pool->mtx));
+
+	while(pool->commit_seq != job->seq && pool->abort == FALSE)
+	    pthread_cond_wait(&(pool->cond_turn), &(pool->mtx));
+
+	pthread_mutex_unlock(&(pool->mtx));
+
+	if (pool->abort == FALSE)
+	{
+	    if (ok == TRUE && pool->app_data->codec_idx != CODEC_RAW && pool->app_data->out_file != NULL)
+		ok = output_write(pool->app_data, job->seq, &buf);
+
+	    if (ok == TRUE && pool->manifest != NULL)
+		ok = (fprintf(pool->manifest, "%u %s\n", pool->app_data->start_index + job->seq, fn) > 0);
+
+	    pthread_mutex_lock(&(pool->mtx));
+
+	    if (ok == TRUE)
+	    {
+		pool->app_data->img_file_count++;
+		pool->bytes_out += len;
+	    }
+	    else
+		pool->failed = TRUE;
+
+	    pool->commit_seq++;
+	    pthread_cond_broadcast(&(pool->cond_turn));
+	    pthread_mutex_unlock(&(pool->mtx));
+	}
+
+	// The sample is kept until now in case the image is written straight from it
+	encode_done(&buf);
+	gst_sample_unref (job->sample);
+	free(job);
+    }
+
+    free(buf.data);
+    free(fn);
+
+    return NULL;
+}
+
+
+/* Write an encoded image to its file (fn is the worker's file name buffer and is left holding the name) */
+
+static int pool_write(FramePool *pool, guint seq, EncBuf *buf, char *fn)
+{
+    AppData *app_data;
+    FILE *fd;
+    guint64 n, f;
+    int ok, stripe;
+
+    app_data = pool->app_data;
+    n = (guint64) app_data->start_index + seq;
+    f = (guint64) app_data->shard_fanout;
+
+    // The template starts with the directory when striped
+    if (app_data->n_out_dirs > 1)
+    {
+	stripe = pool_stripe(pool, n);
+
+	if (app_data->shard_fanout > 1)
+	    sprintf(fn, app_data->filenm_tmpl, app_data->out_dirs[stripe], 
+	    	    (guint) (n / (f * f)), (guint) ((n / f) % f), (guint) n);
+	else
+	    sprintf(fn, app_data->filenm_tmpl, app_data->out_dirs[stripe], (guint) n);
+    }
+    else
+    {
+	stripe = 0;
+
+	if (app_data->shard_fanout > 1)
+	    sprintf(fn, app_data->filenm_tmpl, (guint) (n / (f * f)), (guint) ((n / f) % f), (guint) n);
+	else
+	    sprintf(fn, app_data->filenm_tmpl, (guint) n);
+    }
+
+    if (app_data->shard_fanout > 1 && pool_shard_dir(pool, stripe, n / f, fn) == FALSE)
+	return FALSE;
+
+    if (app_data->writer != NULL)
+	return writer_submit(app_data, fn, buf);
+
+    if ((fd = fopen(fn, "wb")) == NULL)
+    {
+	pool_error(pool, "File", fn, errno);
+	return FALSE;
+    }
+
+    ok = (fwrite(buf->data, 1, buf->len, fd) == buf->len);
+
+    if (ok == TRUE && buf->body_len > 0)
+	ok = (fwrite(buf->body, 1, buf->body_len, fd) == buf->body_len);
+
+    if (fclose(fd) != 0)
+    	ok = FALSE;
+
+    return ok;
+}
+
+
+/* Make sure the shard directories for a file exist. Images are written in about frame order, */
+/* so this is only checked when a different shard is reached, not for every image. */
+
+static int pool_shard_dir(FramePool *pool, int stripe, guint64 shard, char *fn)
+{
+    char *p, *p2;
+    int ok;
+
+    pthread_mutex_lock(&(pool->dir_mtx));
+
+    if (shard == pool->shard[stripe])
+    {
+	pthread_mutex_unlock(&(pool->dir_mtx));
+    	return TRUE;
+    }
+
+    /* Both levels - another segment may make them at the same time, so check again on failure */
+    ok = TRUE;
+    p2 = strrchr(fn, '/');
+    *p2 = '\0';
+    p = strrchr(fn, '/');
+    *p = '\0';
+
+    if (check_dir(fn) == FALSE && make_dir(fn) == FALSE && check_dir(fn) == FALSE)
+    	ok = FALSE;
+
+    *p = '/';
+
+    if (ok == TRUE && check_dir(fn) == FALSE && make_dir(fn) == FALSE && check_dir(fn) == FALSE)
+    	ok = FALSE;
+
+    if (ok == FALSE)
+	pool_error(pool, "Directory", fn, errno);
+
+    *p2 = '/';
+
+    if (ok == TRUE)
+	pool->shard[stripe] = shard;
+
+    pthread_mutex_unlock(&(pool->dir_mtx));
+
+    return ok;
+}
+
+
+/* Note a worker failure - the workers share app_msg_extra with the main loop, so keep the first here */
+
+static void pool_error(FramePool *pool, const char *what, char *fn, int err)
+{
+    pthread_mutex_lock(&(pool->mtx));
+
+    if (pool->err_txt[0] == '\0')
+	snprintf(pool->err_txt, sizeof(pool->err_txt), "%s: %s - error: (%d) %s\n", what, fn, err, strerror(err));
+
+    pthread_mutex_unlock(&(pool->mtx));
+
+    return;
+}
+
+
+/* Choose the stripe directory for an image - in turn, or in proportion to the free space */
+
+static int pool_stripe(FramePool *pool, guint64 n)
+{
+    AppData *app_data;
+    gint64 total;
+    int i, best;
+
+    app_data = pool->app_data;
+
+    if (app_data->stripe_space == FALSE)
+    	return (int) (n % (guint64) app_data->n_out_dirs);
+
+    /* Smooth weighted round-robin - spreads the images out rather than filling one disk at a time */
+    pthread_mutex_lock(&(pool->dir_mtx));
+
+    if ((pool->picks++ % STRIPE_CHECK) == 0)
+    	pool_space(pool);
+
+    total = 0;
+    best = -1;
+
+    for(i = 0; i < app_data->n_out_dirs; i++)
+    {
+	if (pool->weight[i] == 0)
+	    continue;
+
+	pool->current[i] += pool->weight[i];
+	total += pool->weight[i];
+
+	if (best < 0 || pool->current[i] > pool->current[best])
+	    best = i;
+    }
+
+    // All full - carry on in turn and let the write report it
+    if (best < 0)
+	best = (int) (n % (guint64) app_data->n_out_dirs);
+    else
+	pool->current[best] -= total;
+
+    pthread_mutex_unlock(&(pool->dir_mtx));
+
+    return best;
+}
+
+
+/* Free space (MB) in each stripe directory. No check is available elsewhere, so all are the same. */
+
+static void pool_space(FramePool *pool)
+{
+    AppData *app_data;
+    int i;
+
+    app_data = pool->app_data;
+
+    for(i = 0; i < app_data->n_out_dirs; i++)
+    {
+	if ((pool->weight[i] = pool_free_mb(app_data->out_dirs[i])) < 0)
+	    pool->weight[i] = 1;
+    }
+
+    return;
+}
+
+
+/* Free space (MB) for a directory, -1 if it is not known */
+
+static gint64 pool_free_mb(char *dir)
+{
+#ifdef __linux__
+    struct statvfs vfs;
+
+    if (statvfs(dir, &vfs) == 0)
+	return (gint64) (((guint64) vfs.f_bavail * vfs.f_frsize) >> 20);
+#endif
+
+    return -1;
+}
+
+
+/* Check (now and then) if the output disk is nearly full. There must be room for the reserve */
+/* and the images still to come from the frames already taken. Striped in turn, any one full */
+/* disk is enough to stop, striped by space all must be full. */
+
+static int pool_disk_low(FramePool *pool)
+{
+    AppData *app_data;
+    gint64 t, need, mb;
+    int i, n_low;
+
+    app_data = pool->app_data;
+
+    if (app_data->min_free < 0 || (app_data->pack_fn != NULL && pool->disk_dir == NULL))
+    	return FALSE;
+
+    t = g_get_monotonic_time ();
+
+    if (t - pool->t_disk < DISK_CHECK)
+    	return FALSE;
+
+    pool->t_disk = t;
+    need = (app_data->min_free > 0) ? app_data->min_free : DISK_RESERVE;
+
+    pthread_mutex_lock(&(pool->mtx));
+
+    if (pool->commit_seq > 0)
+	need += (gint64) (((pool->bytes_out / pool->commit_seq) * (pool->max_queue + pool->n_workers)) >> 20);
+
+    pthread_mutex_unlock(&(pool->mtx));
+
+    if (pool->disk_dir != NULL)
+	return ((mb = pool_free_mb(pool->disk_dir)) >= 0 && mb < need);
+
+    if (app_data->n_out_dirs <= 1)
+	return ((mb = pool_free_mb(app_data->output_dir)) >= 0 && mb < need);
+
+    for(i = 0, n_low = 0; i < app_data->n_out_dirs; i++)
+    {
+	if ((mb = pool_free_mb(app_data->out_dirs[i])) >= 0 && mb < need)
+	    n_low++;
+    }
+
+    if (app_data->stripe_space == TRUE)
+	return (n_low == app_data->n_out_dirs);
+    else
+	return (n_low > 0);
+}
+
+
+/* Note where a paused conversion got to - in the first directory, one per segment */
+
+static void pool_pause_state(FramePool *pool)
+{
+    AppData *app_data;
+    FILE *fd;
+    char *fn;
+
+    app_data = pool->app_data;
+    fn = (char *) malloc(strlen(app_data->output_dir) + strlen(app_data->img_prefix) + 40);
+
+    if (app_data->seg_no > 0)
+	sprintf(fn, "%s/%sresume-%d.txt", app_data->output_dir, app_data->img_prefix, app_data->seg_no);
+    else
+	sprintf(fn, "%s/%sresume.txt", app_data->output_dir, app_data->img_prefix);
+
+    if ((fd = fopen(fn, "w")) != NULL)
+    {
+	fprintf(fd, "# Output disk nearly full - paused\n");
+	fprintf(fd, "video=%s\n", app_data->video_fn);
+	fprintf(fd, "format=%s\n", app_data->image_type);
+	fprintf(fd, "first_image=%u\n", app_data->start_index);
+	fprintf(fd, "next_image=%u\n", app_data->start_index + pool->commit_seq);
+	fclose(fd);
+    }
+
+    free(fn);
+
+    return;
+}
+
+
+/* Manifest of where each image went - in the first directory, one per segment */
+
+static int pool_manifest_open(FramePool *pool)
+{
+    AppData *app_data;
+    char *fn;
+
+    app_data = pool->app_data;
+    fn = (char *) malloc(strlen(app_data->output_dir) + strlen(app_data->img_prefix) + 40);
+
+    if (app_data->seg_no > 0)
+	sprintf(fn, "%s/%smanifest-%d.txt", app_data->output_dir, app_data->img_prefix, app_data->seg_no);
+    else
+	sprintf(fn, "%s/%smanifest.txt", app_data->output_dir, app_data->img_prefix);
+
+    if ((pool->manifest = fopen(fn, (app_data->resume == TRUE) ? "a" : "w")) == NULL)
+	sprintf(app_msg_extra, "File: %s - error: (%d) %s\n", fn, errno, strerror(errno));
+
+    free(fn);
+
+    return (pool->manifest != NULL);
+}
@@ -0,0 +1,412 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Resume a conversion from the image files already in the output location.
+**		The output is scanned for the image files of the conversion (by prefix, type,
+**		shard and stripe), the last few of them are checked to be whole (the writer
+**		may have been stopped part way through them) and every image still missing -
+**		the end of the conversion and any gaps before it - is converted again with a
+**		segment pipeline seeking to its frames. The numbering is the same as the
+**		original conversion, so the images carry on where they left off.
+**		Nearby gaps are joined so that there are not too many pipelines.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**
+*/
+
+
+
+/* Defines */
+
+#define RESUME_VERIFY 128		// Highest numbered images checked to be whole
+#define RESUME_JOIN 64			// Gaps this close (images) are converted together
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Prototypes */
+
+int resume_convert(AppData *);
+static void resume_scan(AppData *, guint8 *, guint64, char *);
+static void resume_dir(AppData *, char *, int, int, guint8 *, guint64, char *);
+static void resume_path(AppData *, guint64, int, char *, char *);
+static int resume_check(char *, char *);
+static int resume_pnm(FILE *, gint64);
+static int resume_join(guint64 *, guint64 *, int, int);
+static gboolean resume_none(gpointer);
+
+extern int seg_range(AppData *, guint64 *, guint64 *, int *);
+extern int seg_convert(AppData *, guint64 *, guint64 *, int);
+extern void eng_msg(AppData *, char *, char *);
+extern void eng_status(AppData *, char *);
+extern void strlower(char *, char *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-resume.c ";
+
+
+/* Find the images still to do and convert them */
+
+int resume_convert(AppData *app_data)
+{
+    guint8 *have;
+    guint64 f0, f1, span, i, n_missing;
+    guint64 *first, *last;
+    char ext[4], *fn;
+    char s[200];
+    int n, n_max, to_end, ok;
+
+    /* Only separate image files numbered by frame can be picked up */
+    if (app_data->interval_type == 4 || app_data->pack_fn != NULL || strcmp(app_data->image_type, "RAW") == 0 ||
+    	app_data->n_out_dirs > G_MAXUINT8)
+    {
+	eng_msg(app_data, "MSG0001", "Resume (not with keyframes, raw, pack or so many directories)");
+	return FALSE;
+    }
+
+    if (seg_range(app_data, &f0, &f1, &to_end) == FALSE)
+    	return FALSE;
+
+    span = (f1 - f0 + app_data->frame_interval - 1) / app_data->frame_interval;
+    strlower(app_data->image_type, ext);
+
+    /* Images there (the stripe directory + 1 for each, 0 if missing) */
+    have = (guint8 *) calloc(span, 1);
+    resume_scan(app_data, have, span, ext);
+
+    // Any being written when the conversion stopped will be among the last ones
+    fn = (char *) malloc(strlen(app_data->output_dir) + strlen(app_data->img_prefix) + 80);
+
+    for(i = span, n = 0; i > 0 && n < RESUME_VERIFY; i--)
+    {
+	if (have[i - 1] == 0)
+	    continue;
+
+	n++;
+	resume_path(app_data, app_data->start_index + i - 1, have[i - 1] - 1, ext, fn);
+
+	if (resume_check(fn, ext) == FALSE)
+	    have[i - 1] = 0;
+    }
+
+    free(fn);
+
+    /* Runs of missing images */
+    first = NULL;
+    last = NULL;
+    n = 0;
+    n_missing = 0;
+
+    for(i = 0; i < span; i++)
+    {
+	if (have[i] != 0)
+	    continue;
+
+	n_missing++;
+
+	if (n > 0 && last[n - 1] == i)
+	{
+	    last[n - 1] = i + 1;
+	    continue;
+	}
+
+	first = (guint64 *) realloc(first, sizeof(guint64) * (n + 1));
+	last = (guint64 *) realloc(last, sizeof(guint64) * (n + 1));
+	first[n] = i;
+	last[n] = i + 1;
+	n++;
+    }
+
+    free(have);
+
+    if (n == 0)
+    {
+	sprintf(s, "Nothing to resume - all %" G_GUINT64_FORMAT " images are there", span);
+	eng_status(app_data, s);
+	g_idle_add (resume_none, app_data);
+	return TRUE;
+    }
+
+    /* Not too many pipelines */
+    n_max = MAX(1, (int) g_get_num_processors ());
+    n = resume_join(first, last, n, n_max);
+
+    sprintf(s, "Resuming - %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " images missing, converting %d range(s) from image %" 
+    	    G_GUINT64_FORMAT, n_missing, span, n, app_data->start_index + first[0]);
+    eng_status(app_data, s);
+
+    /* Images to frames */
+    for(i = 0; i < (guint64) n; i++)
+    {
+	if (last[i] == span)
+	    last[i] = (to_end == TRUE) ? G_MAXUINT64 : f1;
+	else
+	    last[i] = f0 + last[i] * app_data->frame_interval;
+
+	first[i] = f0 + first[i] * app_data->frame_interval;
+    }
+
+    ok = seg_convert(app_data, first, last, n);
+
+    free(first);
+    free(last);
+
+    return ok;
+}
+
+
+/* Look for the images in each output directory. Any note of a paused conversion is done with. */
+
+static void resume_scan(AppData *app_data, guint8 *have, guint64 span, char *ext)
+{
+    int i, n_dirs;
+    char *dir;
+
+    n_dirs = MAX(1, app_data->n_out_dirs);
+
+    for(i = 0; i < n_dirs; i++)
+    {
+	dir = (app_data->n_out_dirs > 1) ? app_data->out_dirs[i] : app_data->output_dir;
+	resume_dir(app_data, dir, (app_data->shard_fanout > 1) ? 2 : 0, i, have, span, ext);
+    }
+
+    return;
+}
+
+
+/* Mark the images in a directory, going down through any shard directories */
+
+static void resume_dir(AppData *app_data, char *dir, int levels, int stripe, guint8 *have, guint64 span, char *ext)
+{
+    GDir *gdir;
+    const gchar *nm;
+    gchar *path;
+    const char *p;
+    size_t len;
+    guint64 n;
+
+    if ((gdir = g_dir_open (dir, 0, NULL)) == NULL)
+    	return;
+
+    len = strlen(app_data->img_prefix);
+
+    while((nm = g_dir_read_name (gdir)) != NULL)
+    {
+	// Left by a pause (pool.c)
+	if (stripe == 0 && strncmp(nm, app_data->img_prefix, len) == 0 && 
+	    strncmp(nm + len, "resume", 6) == 0 && g_str_has_suffix (nm, ".txt"))
+	{
+	    path = g_build_filename (dir, nm, NULL);
+	    remove(path);
+	    g_free (path);
+	    continue;
+	}
+
+	if (levels > 0)
+	{
+	    path = g_build_filename (dir, nm, NULL);
+	    resume_dir(app_data, path, levels - 1, stripe, have, span, ext);
+	    g_free (path);
+	    continue;
+	}
+
+	if (strncmp(nm, app_data->img_prefix, len) != 0)
+	    continue;
+
+	/* Prefix, 10 digits and the type */
+	for(p = nm + len; isdigit((unsigned char) *p); p++);
+
+	if (p - (nm + len) != 10 || *p != '.' || g_ascii_strcasecmp(p + 1, ext) != 0)
+	    continue;
+
+	n = g_ascii_strtoull(nm + len, NULL, 10);
+
+	if (n >= app_data->start_index && n - app_data->start_index < span)
+	    have[n - app_data->start_index] = (guint8) (stripe + 1);
+    }
+
+    g_dir_close (gdir);
+
+    return;
+}
+
+
+/* Image file name - as the frame pool makes it */
+
+static void resume_path(AppData *app_data, guint64 n, int stripe, char *ext, char *fn)
+{
+    char *dir;
+    guint64 f;
+    int w;
+
+    dir = (app_data->n_out_dirs > 1) ? app_data->out_dirs[stripe] : app_data->output_dir;
+
+    if (app_data->shard_fanout > 1)
+    {
+	f = (guint64) app_data->shard_fanout;
+	w = snprintf(NULL, 0, "%d", app_data->shard_fanout - 1);
+	sprintf(fn, "%s/%0*u/%0*u/%s%010u.%s", dir, w, (guint) (n / (f * f)), w, (guint) ((n / f) % f), 
+		app_data->img_prefix, (guint) n, ext);
+    }
+    else
+    {
+	sprintf(fn, "%s/%s%010u.%s", dir, app_data->img_prefix, (guint) n, ext);
+    }
+
+    return;
+}
+
+
+/* Check that an image file is whole - it has the end (or the size) its type should have */
+
+static int resume_check(char *fn, char *ext)
+{
+    static const guint8 png_end[12] = { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82 };
+    struct stat st;
+    FILE *fd;
+    guint8 b[12];
+    int ok;
+
+    if (stat(fn, &st) != 0 || st.st_size == 0)
+    	return FALSE;
+
+    if ((fd = fopen(fn, "rb")) == NULL)
+    	return FALSE;
+
+    if (strcmp(ext, "jpg") == 0)
+	ok = (fseek(fd, -2, SEEK_END) == 0 && fread(b, 1, 2, fd) == 2 && b[0] == 0xFF && b[1] == 0xD9);
+    else if (strcmp(ext, "png") == 0)
+	ok = (fseek(fd, -12, SEEK_END) == 0 && fread(b, 1, 12, fd) == 12 && memcmp(b, png_end, 12) == 0);
+    else if (strcmp(ext, "bmp") == 0)
+	ok = (fread(b, 1, 6, fd) == 6 && b[0] == 'B' && b[1] == 'M' &&
+	      (gint64) (b[2] | (b[3] << 8) | (b[4] << 16) | ((guint32) b[5] << 24)) == (gint64) st.st_size);
+    else
+	ok = resume_pnm(fd, (gint64) st.st_size);
+
+    fclose(fd);
+
+    return ok;
+}
+
+
+/* PNM - the header gives the size of the pixels after it */
+
+static int resume_pnm(FILE *fd, gint64 size)
+{
+    int type, w, h, maxval, per_px;
+    long hdr;
+
+    if (fscanf(fd, "P%d %d %d %d", &type, &w, &h, &maxval) != 4 || fgetc(fd) == EOF)
+    	return FALSE;
+
+    if ((hdr = ftell(fd)) < 0)
+    	return FALSE;
+
+    switch(type)
+    {
+	case 5:
+	    per_px = 1;
+	    break;
+	case 6:
+	    per_px = 3;
+	    break;
+	default:
+	    return (size > hdr);
+    }
+
+    if (maxval > 255)
+	per_px *= 2;
+
+    return (size == hdr + (gint64) w * h * per_px);
+}
+
+
+/* Join the ranges closest together (the images between are done again) until there are few enough */
+
+static int resume_join(guint64 *first, guint64 *last, int n, int n_max)
+{
+    guint64 gap;
+    int i, j;
+
+    gap = RESUME_JOIN;
+
+    while(1)
+    {
+	for(i = 1, j = 0; i < n; i++)
+	{
+	    if (first[i] - last[j] <= gap)
+	    {
+		last[j] = last[i];
+	    }
+	    else
+	    {
+		j++;
+		first[j] = first[i];
+		last[j] = last[i];
+	    }
+	}
+
+	n = j + 1;
+
+	if (n <= n_max)
+	    break;
+
+	gap *= 2;
+    }
+
+    return n;
+}
+
+
+/* Nothing to do - finished, once the front end is waiting for it */
+
+static gboolean resume_none(gpointer data)
+{
+    AppData *app_data;
+
+    app_data = (AppData *) data;
+
+    if (app_data->cb.finished != NULL)
+	(*app_data->cb.finished)(TRUE, app_data->cb.data);
+
+    return FALSE;
+}
@@ -0,0 +1,410 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Split a conversion into segments and run a pipeline for each one at the same time.
+**		Each segment seeks to its first frame, keeps only its own frames and numbers its
+**		images from where the segment before it ends, so the output is the same as a
+**		single pipeline would give.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Writer statistics totalled
+**	18-Oct-2026	Any set of frame ranges may be run (resume)
+**	18-Oct-2026	Frame index read here for the segments
+**
+*/
+
+
+
+/* Defines */
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+
+/* Typedefs */
+
+typedef struct _seg_job
+{
+    AppData *parent;			/* Conversion as set up by the user */
+    AppData *segs;			/* One per segment */
+    int n_segs;
+    int active;				/* Segments still running */
+    int started;			/* Parent told that conversion has started */
+    int ok;				/* All segments finished ok */
+    guint progress_id;
+} SegJob;
+
+
+/* Prototypes */
+
+int parallel_convert(AppData *, int);
+int seg_range(AppData *, guint64 *, guint64 *, int *);
+int seg_convert(AppData *, guint64 *, guint64 *, int);
+static void seg_msg(char *, char *, void *);
+static void seg_status(char *, void *);
+static void seg_started(void *);
+static void seg_finished(int, void *);
+static gboolean seg_progress(gpointer);
+static gboolean seg_cleanup(gpointer);
+
+extern int run_conversion(AppData *);
+extern void end_conversion(AppData *, int);
+extern void eng_msg(AppData *, char *, char *);
+extern GstClockTime frame_time(AppData *, guint64);
+extern guint64 time_frame(AppData *, GstClockTime);
+extern void video_index(AppData *, int);
+extern void writer_stats_add(WriteStats *, WriteStats *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-segment.c ";
+
+
+/* Run the conversion as a number of segment pipelines */
+
+int parallel_convert(AppData *app_data, int n_segs)
+{
+    guint64 f0, f1, span;
+    guint64 *first, *last;
+    int i, to_end, ok;
+
+    if (seg_range(app_data, &f0, &f1, &to_end) == FALSE)
+    	return FALSE;
+
+    /* Segments start on an interval boundary and no segment is left empty */
+    span = (f1 - f0 + app_data->frame_interval - 1) / app_data->frame_interval;
+
+    if (n_segs < 1)
+    	n_segs = 1;
+
+    if ((guint64) n_segs > span)
+    	n_segs = (int) span;
+
+    first = (guint64 *) malloc(sizeof(guint64) * n_segs);
+    last = (guint64 *) malloc(sizeof(guint64) * n_segs);
+
+    for(i = 0; i < n_segs; i++)
+    {
+	first[i] = f0 + ((span * i) / n_segs) * app_data->frame_interval;
+	last[i] = f0 + ((span * (i + 1)) / n_segs) * app_data->frame_interval;
+    }
+
+    if (to_end == TRUE)
+	last[n_segs - 1] = G_MAXUINT64;
+    else
+	last[n_segs - 1] = f1;
+
+    ok = seg_convert(app_data, first, last, n_segs);
+
+    free(first);
+    free(last);
+
+    return ok;
+}
+
+
+/* Frames to convert (the last is exclusive), TRUE in to_end if that is the end of the video */
+
+int seg_range(AppData *app_data, guint64 *f0, guint64 *f1, int *to_end)
+{
+    GstClockTime start, stop;
+    int mpx;
+
+    /* Need to be able to seek and know the frame rate */
+    if (! app_data->seekable)
+    {
+	eng_msg(app_data, "MSG0010", NULL);
+	return FALSE;
+    }
+
+    if (app_data->fr_num == 0 || app_data->fr_denom == 0 || app_data->video_duration == 0)
+    {
+	eng_msg(app_data, "MSG0004", "Frame rate or duration");
+	return FALSE;
+    }
+
+    // Exact frames and keyframe seeks for the segments (they share this index)
+    video_index(app_data, TRUE);
+
+    /* Range to convert */
+    start = 0;
+    stop = app_data->video_duration;
+
+    if (app_data->interval_type == 2 || app_data->interval_type == 3)
+    {
+	mpx = (app_data->interval_type == 3) ? 60 : 1;
+	start = app_data->time_start * mpx * GST_SECOND;
+
+	if (app_data->time_duration > 0)
+	    stop = (app_data->time_start + app_data->time_duration) * mpx * GST_SECOND;
+    }
+
+    *f0 = time_frame(app_data, start);
+    *f1 = time_frame(app_data, stop);
+    *to_end = (stop == app_data->video_duration);
+
+    if (*f1 <= *f0)
+    {
+	eng_msg(app_data, "MSG0011", NULL);
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* Run a pipeline for each range of frames (first to last, exclusive, G_MAXUINT64 for the end). */
+/* Each range starts on an interval boundary from the start of the whole conversion. */
+
+int seg_convert(AppData *app_data, guint64 *first, guint64 *last, int n_segs)
+{
+    SegJob *job;
+    AppData *seg;
+    guint64 f0, f1;
+    int i, to_end;
+
+    if (seg_range(app_data, &f0, &f1, &to_end) == FALSE)
+    	return FALSE;
+
+    job = (SegJob *) malloc(sizeof(SegJob));
+    memset(job, 0, sizeof(SegJob));
+    job->parent = app_data;
+    job->n_segs = n_segs;
+    job->ok = TRUE;
+    job->segs = (AppData *) malloc(sizeof(AppData) * n_segs);
+
+    app_data->img_file_count = 0;
+    memset(&(app_data->wr_stats), 0, sizeof(WriteStats));
+
+    for(i = 0; i < n_segs; i++)
+    {
+	/* Copy the user settings, but nothing belonging to a pipeline */
+	seg = &(job->segs[i]);
+	memcpy(seg, app_data, sizeof(AppData));
+	memset(&(seg->gst_objs), 0, sizeof(app_gst_objs));
+	seg->c_pipeline = NULL;
+	seg->filenm_tmpl = NULL;
+	seg->info_txt = NULL;
+	seg->discoverer = NULL;
+	seg->loop = NULL;
+	seg->pool = NULL;
+	seg->writer = NULL;
+	// The frame index (findex) is shared - it is only read
+
+	// Share the processors between the segments
+	if (seg->enc_threads == 0)
+	    seg->enc_threads = MAX(1, (int) g_get_num_processors () / n_segs);
+
+	seg->seg_no = i + 1;
+	seg->init_state = GST_STATE_PAUSED;
+	seg->frm_first = first[i];
+	seg->frm_last = last[i];
+	seg->seg_start = frame_time(app_data, first[i]);
+	seg->seg_stop = (last[i] == G_MAXUINT64) ? GST_CLOCK_TIME_NONE : frame_time(app_data, last[i]);
+	seg->start_index = app_data->start_index + (guint) ((first[i] - f0) / app_data->frame_interval);
+	seg->no_of_frames = (guint) ((last[i] == G_MAXUINT64) ? (f1 - first[i]) : (last[i] - first[i]));
+
+	seg->cb.msg = &seg_msg;
+	seg->cb.status = &seg_status;
+	seg->cb.query = NULL;
+	seg->cb.started = &seg_started;
+	seg->cb.finished = &seg_finished;
+	seg->cb.data = (void *) job;
+    }
+
+    /* Start them all - a failure stops those already going */
+    for(i = 0; i < n_segs; i++)
+    {
+	if (run_conversion(&(job->segs[i])) == FALSE)
+	    break;
+
+	job->active++;
+    }
+
+    if (i < n_segs)
+    {
+	// Including the one that failed, it may have started its frame pool and writer
+	for(; i >= 0; i--)
+	{
+	    job->segs[i].cb.finished = NULL;
+	    end_conversion(&(job->segs[i]), FALSE);
+	}
+
+	free(job->segs);
+	free(job);
+	return FALSE;
+    }
+
+    job->progress_id = g_timeout_add (500, seg_progress, job);
+
+    return TRUE;
+}
+
+
+/***** SEGMENT CALLBACKS *****/
+
+
+/* Messages go to the parent front end */
+
+static void seg_msg(char *msg_id, char *opt_str, void *data)
+{
+    SegJob *job;
+
+    job = (SegJob *) data;
+    eng_msg(job->parent, msg_id, opt_str);
+
+    return;
+}
+
+
+/* Individual segment status is not of interest */
+
+static void seg_status(char *s, void *data)
+{
+    return;
+}
+
+
+/* First segment to play starts the parent */
+
+static void seg_started(void *data)
+{
+    SegJob *job;
+
+    job = (SegJob *) data;
+
+    if (job->started == TRUE)
+    	return;
+
+    job->started = TRUE;
+    job->parent->thread_init = TRUE;
+
+    if (job->parent->cb.started != NULL)
+	(*job->parent->cb.started)(job->parent->cb.data);
+
+    return;
+}
+
+
+/* A segment has finished - the parent is finished when all of them are */
+
+static void seg_finished(int ok, void *data)
+{
+    SegJob *job;
+    int i;
+
+    job = (SegJob *) data;
+
+    job->active--;
+
+    /* One failure stops the lot - the others report back here as they end */
+    if (ok == FALSE && job->ok == TRUE)
+    {
+    	job->ok = FALSE;
+
+	if (job->active > 0)
+	{
+	    for(i = 0; i < job->n_segs; i++)
+	    {
+		if (job->segs[i].c_pipeline != NULL)
+		    end_conversion(&(job->segs[i]), FALSE);
+	    }
+
+	    return;
+	}
+    }
+
+    if (job->active > 0)
+    	return;
+
+    // The last bus watch is still using its segment, so tidy up afterwards
+    g_idle_add (seg_cleanup, job);
+
+    return;
+}
+
+
+/* Total the images from all segments */
+
+static gboolean seg_progress(gpointer data)
+{
+    SegJob *job;
+    guint total;
+    int i;
+
+    job = (SegJob *) data;
+    total = 0;
+
+    for(i = 0; i < job->n_segs; i++)
+	total += job->segs[i].img_file_count;
+
+    job->parent->img_file_count = total;
+
+    return TRUE;
+}
+
+
+/* Report to the parent and free up */
+
+static gboolean seg_cleanup(gpointer data)
+{
+    SegJob *job;
+    AppData *app_data;
+    int i, ok;
+
+    job = (SegJob *) data;
+    app_data = job->parent;
+    ok = job->ok;
+
+    if (job->progress_id != 0)
+	g_source_remove (job->progress_id);
+
+    seg_progress(job);
+    app_data->thread_init = FALSE;
+
+    for(i = 0; i < job->n_segs; i++)
+	writer_stats_add(&(app_data->wr_stats), &(job->segs[i].wr_stats));
+
+    free(job->segs);
+    free(job);
+
+    if (app_data->cb.finished != NULL)
+	(*app_data->cb.finished)(ok, app_data->cb.data);
+
+    return FALSE;
+}
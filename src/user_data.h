@@ -48,16 +48,68 @@
 
 /* Enums */
 
+enum codec_idx { CODEC_JPG, CODEC_PNG, CODEC_PNM, CODEC_BMP, CODEC_RAW };		/* Same order as the codec selection */
+enum png_filter { PNG_FLT_ADAPTIVE, PNG_FLT_NONE, PNG_FLT_SUB, PNG_FLT_UP, PNG_FLT_AVG, PNG_FLT_PAETH };
+enum png_strategy { PNG_STRAT_DEFAULT, PNG_STRAT_FILTERED, PNG_STRAT_RLE, PNG_STRAT_HUFFMAN };
+enum raw_fmt { RAW_RGB, RAW_GRAY8, RAW_I420 };
+
 
 /* Structure to group GST elements */
 
 typedef struct _app_gst_objects
 {
     GstElement *file_src, *v_decode, *encoder, *mf_sink;
-    GstElement *v_rate, *v_convert, *px_buf;
+    GstElement *v_convert;
+    GstElement *v_scale, *v_filter;	/* Only when scaling the output */
+    GstElement *v_parse;		/* Only for a possible JPEG passthrough */
+    GstElement *v_caps, *a_sink;	/* Only for the native encoder frame pool */
+    GstElement *v_dec;			/* Decoder chosen by decodebin, if it can skip frames (not ref'd) */
 } app_gst_objs;
 
 
+/* Encoded image held by a frame pool worker (reused for each frame) */
+
+typedef struct _enc_buf
+{
+    guchar *data;
+    gsize len;				/* Bytes used */
+    gsize size;				/* Bytes allocated */
+    guchar *body;			/* Written after data, straight from the frame (BMP) */
+    gsize body_len;
+    GstBuffer *body_buf;		/* Frame kept mapped until the write is done */
+    GstMapInfo body_map;
+} EncBuf;
+
+
+/* Image file writer statistics (writer.c) */
+
+typedef struct _write_stats
+{
+    guint64 files;			/* Files written */
+    guint64 bytes;
+    guint64 lat_total;			/* Time from hand over to closed (usecs) */
+    guint64 lat_max;
+    guint64 stall;			/* Time the workers waited for the writer (usecs) */
+    int max_held;			/* Most files queued or in flight at once */
+    int uring;				/* Written with io_uring, otherwise by a thread */
+    int throttled;			/* Times fewer files were let in because writes were slow */
+} WriteStats;
+
+
+/* Front end callbacks - the conversion engine knows nothing of GTK, so anything shown */
+/* to the user goes back through these (GUI dialogs and labels or command line output) */
+
+typedef struct _eng_callbacks
+{
+    void (*msg)(char *, char *, void *);	/* Message id, substitution string */
+    void (*status)(char *, void *);		/* Status line text */
+    int (*query)(char *, char *, void *);	/* Yes / No question, TRUE for yes */
+    void (*started)(void *);			/* Pipeline is playing */
+    void (*finished)(int, void *);		/* Conversion ended, TRUE if ok */
+    void *data;					/* Passed back to each callback */
+} eng_cb;
+
+
 /* Structure to contain all our information, so we can pass it around */
 
 typedef struct _AppData
@@ -72,18 +124,74 @@ typedef struct _AppData
     int frame_interval;	    		/* Interval (no. of frames) between conversions */
     gint64 time_start;	    		/* Collect frames for a time interval */
     gint64 time_duration;	    	/* Time period */
+    GstClockTime *ranges;		/* Time ranges, start and stop of each (sorted, apart), NULL for one period */
+    int n_ranges;
+    int range_no;			/* Range being converted */
+    GstClockTime seg_start;		/* Segment to convert when split across pipelines */
+    GstClockTime seg_stop;		/* (GST_CLOCK_TIME_NONE for the end of the video) */
+    int seg_no;				/* Segment number, 0 if not a segment */
+    guint64 frm_first;			/* Frames wanted in the segment (last is exclusive) */
+    guint64 frm_last;
+    guint64 frm_count;			/* Frames decoded so far (whole video only) */
+    int sampler;			/* Seek between selected frames when it is cheaper */
+    int seek_req;			/* Sample seek requested, not yet landed */
+    guint64 next_frm;			/* Next frame wanted by the sampler */
+    guint64 last_key;			/* Last keyframe seen (or estimated) */
+    guint64 gop_est;			/* Estimated keyframe spacing */
+    int skip_on;			/* Decoder is skipping non-reference frames */
+    int key_seek;			/* Seeks start on a keyframe from the frame index */
+    GstSegment probe_seg;		/* Current segment seen by the frame probe */
+    guint start_index;			/* Number of the first image file */
     gchar *output_dir;			/* Directory to hold output image files */
     gchar *filenm_tmpl;			/* Image filename template */
     char *image_type;	    		/* Image type (jpg, png, pnm, bmp) */
+    int codec_idx;			/* Image type index (enum codec_idx) */
+    int enc_threads;			/* Frame pool encoder threads, 0 for one per processor */
+    void *pool;				/* Frame pool (pool.c), NULL if the gst encoder is used */
+    int png_level;			/* PNG zlib level 1 - 9, 0 for the default (6) */
+    int png_filter;			/* PNG row filter (enum png_filter) */
+    int png_strategy;			/* PNG zlib strategy (enum png_strategy) */
+    int raw_fmt;			/* RAW frame pixel format (enum raw_fmt) */
+    void *out_file;			/* Single file output (output.c), eg. RAW */
+    char *pack_fn;			/* Images go into this tar archive ("-" for stdout), NULL for files */
+    int shard_fanout;			/* Images (and directories) per shard directory, 0 for none */
+    char **out_dirs;			/* Stripe directories (output_dir is the first), NULL for one */
+    int n_out_dirs;			/* Number of stripe directories */
+    int stripe_space;			/* Stripe by free space, otherwise round-robin */
+    void *writer;			/* Write-behind for image files (writer.c), NULL to write in the pool */
+    int write_depth;			/* Image files queued or in flight, 0 for the default */
+    int sync_write;			/* Frame pool workers write their own files */
+    int min_free;			/* MB kept free on the output disk, 0 for the default, -1 for no check */
+    int resume;				/* Only convert the images not already in the output (resume.c) */
+    WriteStats wr_stats;		/* Filled in when the writer is finished */
     char *img_prefix;			/* Prefix to use for image file names */
+    int out_width;			/* Output image width, 0 for the video size */
+    int passthru;			/* JPEG frames written as they are */
+    int mjpeg;				/* Discovery found JPEG video */
 
     guint fr_denom;			/* Frame rate demoninator */
     guint fr_num;			/* Frame rate numerator */
+    guint v_width;			/* Video width */
     gboolean seekable;			/* Is video seekable */
     gboolean video_ok;			/* Is video discovery ok */
     GstClockTime video_duration;	/* Video length in nanoseconds */
     char *fmt_duration;			/* String duration */
+    char *info_txt;			/* Discovery result text for display */
     GstDiscoverer *discoverer;
+    int discover_retry;			/* Discovery timed out, try again */
+    int no_dcache;			/* Always discover, the cache is only updated (dcache.c) */
+    int disc_max;			/* Videos discovered at once in a batch, 0 for one per processor */
+    int seek_index;			/* Keep the frame index in a sidecar file for later runs (findex.c) */
+    int retry_count;
+
+    guint no_of_frames;			/* Frames in the video (exact if there is a frame index) */
+    void *findex;			/* Frame index from the container (findex.c), NULL if none */
+    int findex_tried;			/* Frame index looked for (video_index) - 0 no, 1 without, 2 with the Matroska scan */
+    guint img_file_count;		/* Images written so far */
+    int thread_init;			/* Progress monitoring started */
+    int seek_play;			/* Play once the seek completes */
+    int seek_sent;			/* Initial seek has been sent */
+    eng_cb cb;				/* Front end callbacks */
 
     GMainLoop *loop;
 } AppData;
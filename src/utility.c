@@ -34,11 +34,6 @@
 */
 
 
-/* Defines */
-
-#define ERR_FILE
-
-
 /* Includes */
 
 #include <stdio.h>
@@ -58,11 +53,9 @@
 /* Prototypes */
 
 void app_msg(char*, char *, GtkWidget*);
-char * app_msg_text(char*, char *);
 void info_dialog(GtkWidget *, char *, char *);
 gint query_dialog(GtkWidget *, char *, char *);
 int choose_file_dialog(char *, int, gchar **, MainUi *);
-void get_msg(char*, char*, char*);
 void string_trim(char*);
 void register_window(GtkWidget *);
 void deregister_window(GtkWidget *);
@@ -71,11 +64,7 @@ void close_open_ui();
 int close_ui(char *);
 int is_ui_reg(char *, int);
 char * home_dir();
-void strlower(char *, char *);
 void dttm_stamp(char *, size_t);
-int check_file(char *);
-int check_dir(char *);
-int make_dir(char *);
 int check_make_dir(char *, GtkWidget *);
 FILE * open_file(char *, char *);
 int read_file(FILE *, char *, int);
@@ -89,45 +78,14 @@ GList * ctrl_widget_list(GtkWidget *, GtkWidget *);
 void delete_menu_items(GtkWidget *, char *);
 
 extern void cur_date_str(char *, int, char *);
+extern void get_msg(char*, char*, char*);
+extern int check_dir(char *);
+extern int make_dir(char *);
 
 
 
 /* Globals */
 
-static const char *app_messages[][2] = 
-{ 
-    { "MSG0001", "Error: %s has an invalid value. "},
-    { "MSG0002", "Error: Please enter a value for %s. "},
-    { "MSG0003", "%s does not exist. "},
-    { "MSG0004", "Error: No %s found. "},
-    { "MSG0005", "Warning: No %s found. "},
-    { "MSG0006", "File error: %s. "},
-    { "MSG0007", "Failed to create image: %s "},
-    { "MSG0008", "File %s does not exist or cannot be read. "},
-    { "MSG0009", "Error: %s has an invalid value. "},
-    { "MSG0010", "Error: This video is not seekable. Cannot convert a video segment. "},
-    { "MSG0011", "Error: The start point is longer the video duration. "},
-    { "MSG9000", "Session started. "},
-    { "MSG9001", "Session ends. "},
-    { "MSG9003", "Failed to start application. "},
-    { "MSG9004", "Failed to read $HOME variable. "},
-    { "MSG9005", "Debug: %s. "},
-    { "MSG9006", "Failed to get parent container widget. %s "},
-    { "MSG9007", "Failed to find widget. %s "},
-    { "MSG9008", "Failed to create directory: %s "},
-    { "MSG9009", "Not all GST elements could be created. "},
-    { "MSG9010", "GST Pipeline elements could not be linked. "},
-    { "MSG9011", "Unable to set the pipeline to the %s state. "},
-    { "MSG9012", "Pipeline Message: %s received. "},
-    { "MSG9013", "Error video creating discoverer. "},
-    { "MSG9014", "Failed to video discoverer for: %s "},
-    { "MSG9015", "Discoverer info result error: %s "},
-    { "MSG9016", "'Video' file - %s - cannot be played "},
-    { "MSG9017", "Error: Unable to create thread, "},
-    { "MSG9999", "Error - Unknown error message given. "}			// NB - MUST be last
-};
-
-static const int Msg_Count = 29;
 static char *Home;
 static const char *debug_hdr = "DEBUG-utility.c ";
 static GList *open_ui_list_head = NULL;
@@ -161,36 +119,6 @@ void app_msg(char *msg_id, char *opt_str, GtkWidget *window)
 }
 
 
-/* Process application messages and error conditions and return text */
-
-char * app_msg_text(char *msg_id, char *opt_str)
-{
-    char msg[512];
-    char *msg_txt;
-    int len;
-
-    /* Lookup the message */
-    get_msg(msg, msg_id, opt_str);
-    strcat(msg, " \n");
-
-    /* Print the message */
-    printf("%s: %s", TITLE, msg); fflush(stdout);
-
-    if (app_msg_extra[0] != '\0')
-	printf("%s\n", app_msg_extra); fflush(stdout);
-
-    /* Set the text */
-    len = strlen(msg) + strlen(app_msg_extra) + 2;
-    msg_txt = (char *) malloc(len);
-    sprintf(msg_txt, "%s%s\n", msg, app_msg_extra);
-
-    /* Reset global message extra details */
-    app_msg_extra[0] = '\0';
-
-    return msg_txt;
-}
-
-
 /* General prupose information dialog */
 
 void info_dialog(GtkWidget *window, char *msg, char *opt)
@@ -282,57 +210,6 @@ char * home_dir(GtkWidget *window)
 }
 
 
-/* Message lookup and optional string argument substitution */
-
-void get_msg(char *s, char *msg_id, char *opt_str)
-{
-    int i;
-    char *p, *p2;
-
-    /* Find message */
-    for(i = 0; i < Msg_Count; i++)
-    {
-    	if ((strcmp(msg_id, app_messages[i][0])) == 0)
-	    break;
-    }
-
-    if (i >= Msg_Count)
-    	i--;
-
-    /* Check substitution. If none, show message as is with any '%s' blanked out. */
-    p = (char *) app_messages[i][1];
-    p2 = strstr(p, "%s");
-
-    if ((! opt_str) || (strlen(opt_str) == 0) || (p2 == NULL))
-    {
-	sprintf(s, "(%s) %s", app_messages[i][0], app_messages[i][1]);
-
-	if (p2 != NULL)
-	{
-	    p2 = strstr(s, "%s");
-	    *p2++ = ' ';
-	    *p2 = ' ';
-	}
-
-    	return;
-    }
-
-    /* Add substitution string */
-    *s = '\0';
-    sprintf(s, "(%s) ", app_messages[i][0]);
-
-    for(s = (s + strlen(app_messages[i][0]) + 3); p < p2; p++)
-    	*s++ = *p;
-
-    *s = '\0';
-
-    strcat(s, opt_str);
-    strcat(s, p2 + 2);
-
-    return;
-}
-
-
 /* Remove leading and trailing spaces from a string */
 
 void string_trim(char *s)
@@ -482,19 +359,6 @@ void free_window_reg()
 }
 
 
-/* Convert a string to lowercase */
-
-void strlower(char *s1, char *s2)
-{
-    for(; *s1 != '\0'; s1++, s2++)
-    	*s2 = tolower(*s1);
-
-    *s2 = *s1;
-
-    return;
-}
-
-
 /* Return a date and time stamp */
 
 void dttm_stamp(char *s, size_t max)
@@ -512,62 +376,6 @@ void dttm_stamp(char *s, size_t max)
 }
 
 
-/* Check file exists and can be opened */
-
-int check_file(char *s)
-{
-    struct stat fileStat;
-    int err;
-
-    if ((err = stat(s, &fileStat)) < 0)
-	return FALSE;
-
-    if ((fileStat.st_mode & S_IFMT) == S_IFREG)
-	return TRUE;
-    else
-	return FALSE;
-}
-
-
-/* Check directory exists */
-
-int check_dir(char *s)
-{
-    struct stat fileStat;
-    int err;
-
-    if ((err = stat(s, &fileStat)) < 0)
-	return FALSE;
-
-    if ((fileStat.st_mode & S_IFMT) == S_IFDIR)
-	return TRUE;
-    else
-	return FALSE;
-}
-
-
-/* Create a directory */
-
-int make_dir(char *s)
-{
-    int err;
-
-    #ifdef __linux__
-	err = mkdir(s, 0700);
-    #else
-	err = mkdir(s);
-    #endif
-
-    if (err != 0)
-    {
-	app_msg("MSG9008", s, NULL);
-	return FALSE;
-    }
-
-    return TRUE;
-}
-
-
 /* Allow option to create a directory */
 
 int check_make_dir(char *dir, GtkWidget *window)
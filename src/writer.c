@@ -0,0 +1,941 @@
+/*
+**  Copyright (C) 2022 Anthony Buckley
+** 
+**  This file is part of Gusto.
+** 
+**  Gusto is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**  
+**  Gusto is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public License
+**  along with Gusto.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+** Description: Write-behind for frame pool image files.
+**		The workers hand over each encoded image and carry on with the next frame,
+**		while one writer thread opens, writes and closes the files. On Linux this is
+**		done with io_uring (raw system calls, kernel 5.6 or later) so that many files
+**		are in flight at once and each pass submits every open, write and close that
+**		is ready in one call. Elsewhere, or if io_uring is not available, the thread
+**		writes the files itself. Only a limited number of files (and bytes) may be
+**		held, after that the workers wait - the time they wait is in the statistics.
+**		When the files take a long time to write (a busy or shared disk) fewer are let
+**		in, so that less memory is held and the pipeline is held up sooner.
+**		No GTK is used here.
+**
+** Author:	Anthony Buckley
+**
+** History
+**	18-Oct-2026	Initial code
+**	18-Oct-2026	Fewer files held when writes are slow
+**	18-Oct-2026	Files in a failed io_uring are finished as failed and the ring dropped
+**
+*/
+
+
+
+/* Defines */
+
+#define WRITE_DEPTH 64			// Files queued or in flight by default
+#define WRITE_MAX_BYTES (256 << 20)	// Bytes held before the workers wait (one file may always go)
+#define WRITE_SLOW 250000		// Average latency (usecs) above which fewer files are held
+#define WRITE_MIN_HELD 2
+
+#ifndef __linux__
+# define __USE_MINGW_ANSI_STDIO
+#endif
+
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <user_data.h>
+#include <defs.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  endif
+# endif
+#endif
+
+// The ring is only used if the headers know of the kernel 5.6 operations (open, close and write)
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+# define WR_URING
+#endif
+
+
+/* Typedefs */
+
+enum wr_state { WR_OPEN, WR_WRITE, WR_CLOSE };
+
+typedef struct _write_job
+{
+    char *fn;
+    guchar *data;			/* Encoded image, taken from the worker */
+    gsize size;				/* Bytes allocated */
+    gsize len;
+    GstBuffer *body_buf;		/* Frame written after the data (BMP), held until written */
+    GstMapInfo body_map;
+    gsize body_len;
+    gsize done;				/* Bytes written */
+    int fd;
+    int state;				/* enum wr_state */
+    int err;				/* First error, 0 if none */
+    gint64 t_start;
+#ifdef WR_URING
+    struct iovec iov[2];
+#endif
+} WriteJob;
+
+#ifdef WR_URING
+typedef struct _uring
+{
+    int fd;
+    unsigned entries;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_sz, cq_sz, sqes_sz;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;			/* Queued, not yet given to the kernel */
+    int in_flight;			/* Files with an operation in the ring */
+    GQueue jobs;			/* Those files */
+} Uring;
+#endif
+
+typedef struct _writer
+{
+    AppData *app_data;
+    pthread_t tid;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond_job;		/* A file is waiting or the writer is stopping */
+    pthread_cond_t cond_space;		/* Room for another file */
+    GQueue *queue;			/* Files waiting to be started */
+    GQueue *spare;			/* Written, the buffers are given back to the workers */
+    int depth;
+    int limit;				/* Files that may be held now (depth, less if writes are slow) */
+    gint64 lat_avg;			/* Recent latency (usecs) */
+    int n_done;				/* Files since the limit was last looked at */
+    int held;				/* Files queued or in flight */
+    gsize held_bytes;
+    int stopping;			/* No more files coming, finish the queue */
+    int abort;				/* Start no more files */
+    int failed;
+    char err_txt[256];			/* First failure */
+    WriteStats stats;
+#ifdef WR_URING
+    Uring *ring;			/* NULL if io_uring is not available */
+#endif
+} Writer;
+
+
+/* Prototypes */
+
+int writer_open(AppData *);
+int writer_submit(AppData *, char *, EncBuf *);
+int writer_close(AppData *, int);
+void writer_stats_add(WriteStats *, WriteStats *);
+static void * writer_thread(void *);
+static void writer_sync(Writer *, WriteJob *);
+static void writer_done(Writer *, WriteJob *);
+static void writer_fail(Writer *, WriteJob *, int);
+static void writer_error(Writer *, char *, int);
+#ifdef WR_URING
+static Uring * uring_open(unsigned);
+static void uring_close(Uring *);
+static void uring_run(Writer *, GQueue *);
+static void uring_abandon(Writer *, int);
+static void uring_prep(Uring *, WriteJob *);
+static int uring_enter(Uring *, unsigned);
+static void uring_sqe(Uring *, int, int, void *, unsigned, guint64, WriteJob *);
+static void uring_reap(Writer *);
+static void uring_step(Writer *, WriteJob *, int);
+#endif
+
+extern void eng_msg(AppData *, char *, char *);
+
+
+/* Globals */
+
+static const char *debug_hdr = "DEBUG-writer.c ";
+
+
+/* Start the writer */
+
+int writer_open(AppData *app_data)
+{
+    Writer *wr;
+    int p_err;
+
+    wr = (Writer *) malloc(sizeof(Writer));
+    memset(wr, 0, sizeof(Writer));
+    wr->app_data = app_data;
+    wr->depth = (app_data->write_depth > 0) ? app_data->write_depth : WRITE_DEPTH;
+    wr->limit = wr->depth;
+    wr->queue = g_queue_new ();
+    wr->spare = g_queue_new ();
+    pthread_mutex_init(&(wr->mtx), NULL);
+    pthread_cond_init(&(wr->cond_job), NULL);
+    pthread_cond_init(&(wr->cond_space), NULL);
+
+#ifdef WR_URING
+    // Not all kernels have it, or allow it - the thread writes the files if not
+    if ((wr->ring = uring_open((unsigned) wr->depth)) != NULL)
+	wr->stats.uring = TRUE;
+#endif
+
+    if ((p_err = pthread_create(&(wr->tid), NULL, writer_thread, (void *) wr)) != 0)
+    {
+	sprintf(app_msg_extra, "Error: %s", strerror(p_err));
+	eng_msg(app_data, "MSG9017", NULL);
+#ifdef WR_URING
+	if (wr->ring != NULL)
+	    uring_close(wr->ring);
+#endif
+	g_queue_free (wr->queue);
+	g_queue_free (wr->spare);
+	pthread_mutex_destroy(&(wr->mtx));
+	pthread_cond_destroy(&(wr->cond_job));
+	pthread_cond_destroy(&(wr->cond_space));
+	free(wr);
+	return FALSE;
+    }
+
+    app_data->writer = (void *) wr;
+
+    return TRUE;
+}
+
+
+/* Hand over an image to be written. The image buffer is swapped for a spent one, so the worker */
+/* encodes the next image while this one is written. FALSE if the writer has failed. */
+
+int writer_submit(AppData *app_data, char *fn, EncBuf *buf)
+{
+    Writer *wr;
+    WriteJob *job;
+    gsize len;
+    gint64 t;
+    guchar *p;
+
+    wr = (Writer *) app_data->writer;
+    len = buf->len + buf->body_len;
+    t = 0;
+
+    pthread_mutex_lock(&(wr->mtx));
+
+    while((wr->held >= wr->limit || (wr->held > 0 && wr->held_bytes + len > WRITE_MAX_BYTES)) &&
+    	  wr->abort == FALSE && wr->failed == FALSE)
+    {
+	if (t == 0)
+	    t = g_get_monotonic_time ();
+
+	pthread_cond_wait(&(wr->cond_space), &(wr->mtx));
+    }
+
+    if (t != 0)
+	wr->stats.stall += (guint64) (g_get_monotonic_time () - t);
+
+    if (wr->abort == TRUE || wr->failed == TRUE)
+    {
+	pthread_mutex_unlock(&(wr->mtx));
+	return FALSE;
+    }
+
+    if ((job = (WriteJob *) g_queue_pop_head (wr->spare)) == NULL)
+    {
+	job = (WriteJob *) malloc(sizeof(WriteJob));
+	memset(job, 0, sizeof(WriteJob));
+    }
+
+    wr->held++;
+    wr->held_bytes += len;
+
+    if (wr->held > wr->stats.max_held)
+	wr->stats.max_held = wr->held;
+
+    pthread_mutex_unlock(&(wr->mtx));
+
+    /* Swap the buffers */
+    p = job->data;
+    job->data = buf->data;
+    buf->data = p;
+    len = job->size;
+    job->size = buf->size;
+    buf->size = len;
+    job->len = buf->len;
+    buf->len = 0;
+
+    // A frame written as it is stays mapped (and held) until it is written
+    if (buf->body_buf != NULL)
+    {
+	job->body_buf = gst_buffer_ref (buf->body_buf);
+	job->body_map = buf->body_map;
+	job->body_len = buf->body_len;
+	buf->body_buf = NULL;
+	buf->body = NULL;
+	buf->body_len = 0;
+    }
+
+    job->fn = g_strdup (fn);
+    job->done = 0;
+    job->fd = -1;
+    job->state = WR_OPEN;
+    job->err = 0;
+    job->t_start = g_get_monotonic_time ();
+
+    pthread_mutex_lock(&(wr->mtx));
+    g_queue_push_tail (wr->queue, job);
+    pthread_cond_signal(&(wr->cond_job));
+    pthread_mutex_unlock(&(wr->mtx));
+
+    return TRUE;
+}
+
+
+/* Stop the writer - either finish the files already handed over or abandon those not started */
+/* (any in flight are always finished). FALSE if a file failed, the reason is in app_msg_extra. */
+
+int writer_close(AppData *app_data, int drain)
+{
+    Writer *wr;
+    WriteJob *job;
+    int ok;
+
+    if ((wr = (Writer *) app_data->writer) == NULL)
+    	return TRUE;
+
+    pthread_mutex_lock(&(wr->mtx));
+
+    if (drain == TRUE)
+	wr->stopping = TRUE;
+    else
+	wr->abort = TRUE;
+
+    pthread_cond_broadcast(&(wr->cond_job));
+    pthread_cond_broadcast(&(wr->cond_space));
+    pthread_mutex_unlock(&(wr->mtx));
+
+    pthread_join(wr->tid, NULL);
+
+    /* Abandoned and spent files */
+    while((job = (WriteJob *) g_queue_pop_head (wr->queue)) != NULL)
+    {
+	if (job->body_buf != NULL)
+	{
+	    gst_buffer_unmap (job->body_buf, &(job->body_map));
+	    gst_buffer_unref (job->body_buf);
+	}
+
+	g_free (job->fn);
+	free(job->data);
+	free(job);
+    }
+
+    while((job = (WriteJob *) g_queue_pop_head (wr->spare)) != NULL)
+    {
+	free(job->data);
+	free(job);
+    }
+
+    ok = (wr->failed == FALSE);
+
+    if (ok == FALSE)
+	strcpy(app_msg_extra, wr->err_txt);
+
+#ifdef WR_URING
+    if (wr->ring != NULL)
+	uring_close(wr->ring);
+#endif
+
+    app_data->wr_stats = wr->stats;
+
+    g_queue_free (wr->queue);
+    g_queue_free (wr->spare);
+    pthread_mutex_destroy(&(wr->mtx));
+    pthread_cond_destroy(&(wr->cond_job));
+    pthread_cond_destroy(&(wr->cond_space));
+    free(wr);
+    app_data->writer = NULL;
+
+    return ok;
+}
+
+
+/* Add one set of statistics to another (segments or batch jobs to the whole). */
+/* Counters are summed, high water marks are the largest of any writer. */
+
+void writer_stats_add(WriteStats *tot, WriteStats *st)
+{
+    tot->files += st->files;
+    tot->bytes += st->bytes;
+    tot->lat_total += st->lat_total;
+    tot->stall += st->stall;
+    tot->uring |= st->uring;
+    tot->throttled += st->throttled;
+
+    if (st->lat_max > tot->lat_max)
+	tot->lat_max = st->lat_max;
+
+    if (st->max_held > tot->max_held)
+	tot->max_held = st->max_held;
+
+    return;
+}
+
+
+/* Writer thread - take the waiting files and write them */
+
+static void * writer_thread(void *arg)
+{
+    Writer *wr;
+    WriteJob *job;
+    GQueue batch = G_QUEUE_INIT;
+    int busy, room;
+
+    wr = (Writer *) arg;
+
+    while(1)
+    {
+	busy = FALSE;
+	room = 1;
+
+#ifdef WR_URING
+	if (wr->ring != NULL)
+	{
+	    busy = (wr->ring->in_flight > 0);
+	    room = (int) wr->ring->entries - wr->ring->in_flight;
+	}
+#endif
+
+	pthread_mutex_lock(&(wr->mtx));
+
+	// With files in flight there is no waiting here, the ring waits for them to progress
+	while(g_queue_is_empty (wr->queue) && busy == FALSE && wr->stopping == FALSE && wr->abort == FALSE)
+	    pthread_cond_wait(&(wr->cond_job), &(wr->mtx));
+
+	while(wr->abort == FALSE && room-- > 0 && (job = (WriteJob *) g_queue_pop_head (wr->queue)) != NULL)
+	    g_queue_push_tail (&batch, job);
+
+	pthread_mutex_unlock(&(wr->mtx));
+
+	if (g_queue_is_empty (&batch) && busy == FALSE)
+	    break;
+
+#ifdef WR_URING
+	if (wr->ring != NULL)
+	{
+	    uring_run(wr, &batch);
+	    continue;
+	}
+#endif
+
+	while((job = (WriteJob *) g_queue_pop_head (&batch)) != NULL)
+	    writer_sync(wr, job);
+    }
+
+    return NULL;
+}
+
+
+/* Write a file here and now */
+
+static void writer_sync(Writer *wr, WriteJob *job)
+{
+    FILE *fd;
+
+    if ((fd = fopen(job->fn, "wb")) == NULL)
+    {
+	writer_fail(wr, job, errno);
+	writer_done(wr, job);
+	return;
+    }
+
+    if (fwrite(job->data, 1, job->len, fd) != job->len)
+	writer_fail(wr, job, errno);
+    else if (job->body_len > 0 && fwrite(job->body_map.data, 1, job->body_len, fd) != job->body_len)
+	writer_fail(wr, job, errno);
+
+    if (fclose(fd) != 0)
+	writer_fail(wr, job, errno);
+
+    job->done = job->len + job->body_len;
+    writer_done(wr, job);
+
+    return;
+}
+
+
+/* A file is finished with - count it and give its buffer back */
+
+static void writer_done(Writer *wr, WriteJob *job)
+{
+    guint64 lat;
+    gsize len;
+
+    len = job->len + job->body_len;
+
+    if (job->body_buf != NULL)
+    {
+	gst_buffer_unmap (job->body_buf, &(job->body_map));
+	gst_buffer_unref (job->body_buf);
+	job->body_buf = NULL;
+	job->body_len = 0;
+    }
+
+    g_free (job->fn);
+    job->fn = NULL;
+    lat = (guint64) (g_get_monotonic_time () - job->t_start);
+
+    pthread_mutex_lock(&(wr->mtx));
+
+    if (job->err == 0)
+    {
+	wr->stats.files++;
+	wr->stats.bytes += job->done;
+	wr->stats.lat_total += lat;
+
+	if (lat > wr->stats.lat_max)
+	    wr->stats.lat_max = lat;
+
+	// Halve the files held while writes are slow, let them back in one at a time after
+	wr->lat_avg = (wr->lat_avg * 7 + (gint64) lat) / 8;
+
+	if (++(wr->n_done) >= wr->limit)
+	{
+	    wr->n_done = 0;
+
+	    if (wr->lat_avg > WRITE_SLOW && wr->limit > WRITE_MIN_HELD)
+	    {
+		wr->limit = MAX(WRITE_MIN_HELD, wr->limit / 2);
+		wr->stats.throttled++;
+	    }
+	    else if (wr->lat_avg < WRITE_SLOW / 4 && wr->limit < wr->depth)
+	    {
+		wr->limit++;
+	    }
+	}
+    }
+
+    wr->held--;
+    wr->held_bytes -= len;
+
+    // Keep no more buffers than could be held
+    if ((int) g_queue_get_length (wr->spare) < wr->depth)
+    {
+	g_queue_push_tail (wr->spare, job);
+	job = NULL;
+    }
+
+    pthread_cond_broadcast(&(wr->cond_space));
+    pthread_mutex_unlock(&(wr->mtx));
+
+    if (job != NULL)
+    {
+	free(job->data);
+	free(job);
+    }
+
+    return;
+}
+
+
+/* Note a failure - the first one is reported when the writer is closed */
+
+static void writer_fail(Writer *wr, WriteJob *job, int err)
+{
+    if (job->err != 0)
+    	return;
+
+    job->err = (err != 0) ? err : EIO;
+    writer_error(wr, job->fn, job->err);
+
+    return;
+}
+
+
+/* The writer has failed - the workers are told when they next hand over an image */
+
+static void writer_error(Writer *wr, char *nm, int err)
+{
+    pthread_mutex_lock(&(wr->mtx));
+
+    if (wr->failed == FALSE)
+    {
+	snprintf(wr->err_txt, sizeof(wr->err_txt), "File: %s - error: (%d) %s\n", nm, err, strerror(err));
+	wr->failed = TRUE;
+	pthread_cond_broadcast(&(wr->cond_space));
+    }
+
+    pthread_mutex_unlock(&(wr->mtx));
+
+    return;
+}
+
+
+#ifdef WR_URING
+
+/***** IO_URING *****/
+
+
+/* Set up a ring - each file has only one operation in it at a time, so entries is the most in flight */
+
+static Uring * uring_open(unsigned entries)
+{
+    Uring *ring;
+    struct io_uring_params p;
+    int fd;
+
+    memset(&p, 0, sizeof(p));
+
+    if ((fd = (int) syscall(__NR_io_uring_setup, entries, &p)) < 0)
+    	return NULL;
+
+    // Open, write and close in the ring came with the same kernel as this
+    if ((p.features & IORING_FEAT_RW_CUR_POS) == 0)
+    {
+	close(fd);
+    	return NULL;
+    }
+
+    ring = (Uring *) malloc(sizeof(Uring));
+    memset(ring, 0, sizeof(Uring));
+    ring->fd = fd;
+    ring->entries = p.sq_entries;
+    ring->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+	if (ring->cq_sz > ring->sq_sz)
+	    ring->sq_sz = ring->cq_sz;
+
+	ring->cq_sz = 0;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cq_ptr = ring->sq_ptr;
+
+    if (ring->sq_ptr != MAP_FAILED && ring->cq_sz > 0)
+	ring->cq_ptr = mmap(NULL, ring->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, 
+			    fd, IORING_OFF_CQ_RING);
+
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE, 
+					      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+	uring_close(ring);
+	return NULL;
+    }
+
+    ring->sq_head = (unsigned *) ((char *) ring->sq_ptr + p.sq_off.head);
+    ring->sq_tail = (unsigned *) ((char *) ring->sq_ptr + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) ((char *) ring->sq_ptr + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) ((char *) ring->sq_ptr + p.sq_off.array);
+    ring->cq_head = (unsigned *) ((char *) ring->cq_ptr + p.cq_off.head);
+    ring->cq_tail = (unsigned *) ((char *) ring->cq_ptr + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) ((char *) ring->cq_ptr + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ptr + p.cq_off.cqes);
+
+    return ring;
+}
+
+
+/* Release the ring */
+
+static void uring_close(Uring *ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+	munmap(ring->sqes, ring->sqes_sz);
+
+    if (ring->cq_sz > 0 && ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED)
+	munmap(ring->cq_ptr, ring->cq_sz);
+
+    if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED)
+	munmap(ring->sq_ptr, ring->sq_sz);
+
+    close(ring->fd);
+    free(ring);
+
+    return;
+}
+
+
+/* Start the new files, submit everything ready and wait for at least one operation to finish */
+
+static void uring_run(Writer *wr, GQueue *batch)
+{
+    Uring *ring;
+    WriteJob *job;
+    int err;
+
+    ring = wr->ring;
+
+    while((job = (WriteJob *) g_queue_pop_head (batch)) != NULL)
+    {
+	uring_prep(ring, job);
+	ring->in_flight++;
+	g_queue_push_tail (&(ring->jobs), job);
+    }
+
+    // The ring is no use if this fails
+    if (uring_enter(ring, 1) == FALSE)
+    {
+	err = errno;
+	writer_error(wr, "io_uring", err);
+	uring_abandon(wr, err);
+	return;
+    }
+
+    uring_reap(wr);
+
+    return;
+}
+
+
+/* The ring has failed - close it (the kernel lets go of what was in it) and finish each file that */
+/* was in it as failed, so its buffers and place in the queue are given back. Any files after */
+/* this are written without the ring. */
+
+static void uring_abandon(Writer *wr, int err)
+{
+    Uring *ring;
+    WriteJob *job;
+    GQueue jobs;
+
+    ring = wr->ring;
+    jobs = ring->jobs;
+    wr->ring = NULL;
+    uring_close(ring);
+
+    while((job = (WriteJob *) g_queue_pop_head (&jobs)) != NULL)
+    {
+	// An open file is closed here, unless its close was already in the ring
+	if (job->state == WR_WRITE)
+	    close(job->fd);
+
+	unlink(job->fn);
+	writer_fail(wr, job, err);
+	writer_done(wr, job);
+    }
+
+    return;
+}
+
+
+/* Queue the next operation for a file */
+
+static void uring_prep(Uring *ring, WriteJob *job)
+{
+    gsize off;
+    int n;
+
+    switch(job->state)
+    {
+	case WR_OPEN:
+	    uring_sqe(ring, IORING_OP_OPENAT, AT_FDCWD, job->fn, 0666, 0, job);
+	    break;
+
+	case WR_WRITE:
+	    // Whatever is left of the data and the frame after it
+	    n = 0;
+	    off = job->done;
+
+	    if (off < job->len)
+	    {
+		job->iov[n].iov_base = job->data + off;
+		job->iov[n++].iov_len = job->len - off;
+		off = 0;
+	    }
+	    else
+	    {
+		off -= job->len;
+	    }
+
+	    if (job->body_len > off)
+	    {
+		job->iov[n].iov_base = job->body_map.data + off;
+		job->iov[n++].iov_len = job->body_len - off;
+	    }
+
+	    uring_sqe(ring, IORING_OP_WRITEV, job->fd, job->iov, (unsigned) n, (guint64) job->done, job);
+	    break;
+
+	case WR_CLOSE:
+	    uring_sqe(ring, IORING_OP_CLOSE, job->fd, NULL, 0, 0, job);
+	    break;
+    }
+
+    return;
+}
+
+
+/* Fill in the next submission queue entry. There is always room as each file has at most one. */
+
+static void uring_sqe(Uring *ring, int op, int fd, void *addr, unsigned len, guint64 off, WriteJob *job)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, idx;
+
+    tail = *(ring->sq_tail);
+    idx = tail & *(ring->sq_mask);
+    sqe = &(ring->sqes[idx]);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = (__u8) op;
+    sqe->fd = fd;
+    sqe->addr = (__u64) (uintptr_t) addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = (__u64) (uintptr_t) job;
+
+    if (op == IORING_OP_OPENAT)
+	sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    ring->sq_array[idx] = idx;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return;
+}
+
+
+/* Submit the queued operations and wait for some to finish. FALSE if the ring has failed. */
+
+static int uring_enter(Uring *ring, unsigned min_complete)
+{
+    int ret;
+
+    while(1)
+    {
+	ret = (int) syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, min_complete, 
+			    IORING_ENTER_GETEVENTS, NULL, 0);
+
+	if (ret >= 0)
+	{
+	    ring->to_submit -= (unsigned) ret;
+	    return TRUE;
+	}
+
+	// Busy means completions are waiting to be reaped, which the caller does next
+	if (errno == EBUSY || errno == EAGAIN)
+	    return TRUE;
+
+	if (errno != EINTR)
+	    return FALSE;
+    }
+}
+
+
+/* Take the finished operations and move each file on */
+
+static void uring_reap(Writer *wr)
+{
+    Uring *ring;
+    struct io_uring_cqe *cqe;
+    WriteJob *job;
+    unsigned head;
+    int res;
+
+    ring = wr->ring;
+    head = *(ring->cq_head);
+
+    while(head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+	cqe = &(ring->cqes[head & *(ring->cq_mask)]);
+	job = (WriteJob *) (uintptr_t) cqe->user_data;
+	res = cqe->res;
+	head++;
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	uring_step(wr, job, res);
+    }
+
+    return;
+}
+
+
+/* An operation has finished - queue the next one for the file, or finish with it */
+
+static void uring_step(Writer *wr, WriteJob *job, int res)
+{
+    Uring *ring;
+
+    ring = wr->ring;
+
+    switch(job->state)
+    {
+	case WR_OPEN:
+	    if (res < 0)
+	    {
+		writer_fail(wr, job, -res);
+		break;
+	    }
+
+	    job->fd = res;
+	    job->state = WR_WRITE;
+	    uring_prep(ring, job);
+	    return;
+
+	case WR_WRITE:
+	    if (res == -EINTR || res == -EAGAIN)
+	    {
+		uring_prep(ring, job);
+		return;
+	    }
+
+	    // Nothing written is treated as a full disk
+	    if (res <= 0)
+		writer_fail(wr, job, (res < 0) ? -res : ENOSPC);
+	    else
+		job->done += (gsize) res;
+
+	    if (job->err == 0 && job->done < job->len + job->body_len)
+	    {
+		uring_prep(ring, job);
+		return;
+	    }
+
+	    job->state = WR_CLOSE;
+	    uring_prep(ring, job);
+	    return;
+
+	case WR_CLOSE:
+	    if (res < 0)
+		writer_fail(wr, job, -res);
+
+	    break;
+    }
+
+    ring->in_flight--;
+    g_queue_remove (&(ring->jobs), job);
+    writer_done(wr, job);
+
+    return;
+}
+
+#endif